@@ -0,0 +1,56 @@
+/* C API for running the simulator's allocation policies on real memory.
+ *
+ *   memsim_arena* a = memsim_arena_create(64 << 20, MEMSIM_BEST_FIT);
+ *   char* p = memsim_arena_alloc(a, 100);
+ *   p = memsim_arena_realloc(a, p, 300);
+ *   memsim_arena_free(a, p);
+ *   memsim_arena_destroy(a);
+ *
+ * Each arena is an mmap'd region managed by one allocator. Pointers are
+ * 16-byte aligned. An arena is not thread-safe.
+ *
+ * Link with libmemsim_arena.so; for a whole program, LD_PRELOAD
+ * libmemsim_malloc.so instead (see src/preload/malloc_shim.cpp).
+ */
+#ifndef MEMSIM_ARENA_H
+#define MEMSIM_ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct memsim_arena memsim_arena;
+
+typedef enum {
+    MEMSIM_FIRST_FIT,
+    MEMSIM_BEST_FIT,
+    MEMSIM_WORST_FIT,
+    MEMSIM_BUDDY        /* size rounded down to a power of two, max 1 GiB */
+} memsim_policy;
+
+/* NULL if the region cannot be mapped */
+memsim_arena* memsim_arena_create(size_t bytes, memsim_policy policy);
+void memsim_arena_destroy(memsim_arena* arena);
+
+/* NULL when the arena has no room; alignment must be a power of two */
+void* memsim_arena_alloc(memsim_arena* arena, size_t size);
+void* memsim_arena_alloc_aligned(memsim_arena* arena, size_t size, size_t alignment);
+/* Pointers from another arena or from malloc are ignored */
+void memsim_arena_free(memsim_arena* arena, void* ptr);
+/* Same contract as realloc: NULL on failure with ptr left allocated */
+void* memsim_arena_realloc(memsim_arena* arena, void* ptr, size_t size);
+
+int memsim_arena_owns(const memsim_arena* arena, const void* ptr);
+size_t memsim_arena_usable_size(const memsim_arena* arena, const void* ptr);
+
+/* The allocator's statistics, as "stats all" prints them, then the bytes
+   lost to rounding requests up to 16, to stdout */
+void memsim_arena_print_stats(const memsim_arena* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+#!/bin/bash
+
+echo "========================================"
+echo " Running Memory Simulator Test Suite"
+echo "========================================"
+
+mkdir -p tests/output
+
+run_test () {
+    local input_file=$1
+    local output_file=$2
+
+    echo "Running test: $input_file"
+    ./memsim < tests/$input_file > tests/output/$output_file
+    echo "✔ Output saved to tests/output/$output_file"
+    echo "----------------------------------------"
+}
+
+run_test buddy_basic.txt buddy_basic.out
+run_test buddy_merge.txt buddy_merge.out
+run_test buddy_internal_fragmentation.txt buddy_internal_fragmentation.out
+
+run_test first_fit_basic.txt first_fit_basic.out
+run_test best_fit_fragmentation.txt best_fit_fragmentation.out
+run_test worst_fit_behavior.txt worst_fit_behavior.out
+
+run_test cache_log.txt cache_log.out
+run_test cache_11_12.txt cache_11_12.out
+
+run_test virtual_memory_basic.txt virtual_memory_basic.out
+
+run_test tiered_memory.txt tiered_memory.out
+run_test swap_readahead.txt swap_readahead.out
+
+run_test trace_roundtrip.txt trace_roundtrip.out
+run_test realloc_aligned.txt realloc_aligned.out
+run_test compaction.txt compaction.out
+run_test stats_series.txt stats_series.out
+run_test workload.txt workload.out
+run_test checkpoint.txt checkpoint.out
+run_test engines.txt engines.out
+run_test buddy_pcp.txt buddy_pcp.out
+run_test attribution.txt attribution.out
+run_test qos.txt qos.out
+
+run_test full_pipeline.txt full_pipeline.out
+
+echo "========================================"
+echo " All tests completed successfully"
+echo " Outputs are in tests/output/"
+echo "========================================"
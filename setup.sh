@@ -43,6 +43,20 @@ run_test cache_11_12.txt cache_11_12.out
 
 run_test virtual_memory_basic.txt virtual_memory_basic.out
 
+run_test tiered_memory.txt tiered_memory.out
+run_test swap_readahead.txt swap_readahead.out
+
+run_test trace_roundtrip.txt trace_roundtrip.out
+run_test realloc_aligned.txt realloc_aligned.out
+run_test compaction.txt compaction.out
+run_test stats_series.txt stats_series.out
+run_test workload.txt workload.out
+run_test checkpoint.txt checkpoint.out
+run_test engines.txt engines.out
+run_test buddy_pcp.txt buddy_pcp.out
+run_test attribution.txt attribution.out
+run_test qos.txt qos.out
+
 run_test full_pipeline.txt full_pipeline.out
 
 echo "========================================"
@@ -59,19 +73,103 @@ echo "✔ run_tests.sh created"
 # -------------------------------------------------
 echo "[2/3] Compiling Memory Simulator..."
 
-g++ -std=gnu++20 \
+# MEMSIM_PROFILE=1 ./setup.sh builds in the hot-path probes ("profile stats")
+PROFILE_FLAGS=""
+if [ "$MEMSIM_PROFILE" = "1" ]; then
+    PROFILE_FLAGS="-O2 -DMEMSIM_PROFILE"
+fi
+
+g++ -std=gnu++20 $PROFILE_FLAGS \
     -Isrc \
     -Iinclude \
+    -pthread \
     src/main.cpp \
+    src/simulator/simulator.cpp \
+    src/stats/stats_registry.cpp \
+    src/profile/profiler.cpp \
+    src/io/output.cpp \
+    src/trace/trace_format.cpp \
+    src/trace/trace_writer.cpp \
+    src/trace/trace_reader.cpp \
+    src/trace/alloc_import.cpp \
     src/allocator/memory_manager.cpp \
     src/cache/cache.cpp \
     src/virtual_memory/VirtualMemory.cpp \
     src/virtual_memory/TLB.cpp \
+    src/virtual_memory/TieredMemory.cpp \
+    src/virtual_memory/BackingStore.cpp \
     src/buddy/buddy_allocator.cpp \
+    src/workload/workload_generator.cpp \
+    src/checkpoint/checkpoint.cpp \
+    src/attribution/miss_attribution.cpp \
+    src/qos/bandwidth_throttle.cpp \
     -o memsim
 
 echo "✔ Compilation successful: memsim created"
 
+# Microbenchmarks, always optimised (see "./memsim_bench --help")
+g++ -std=gnu++20 -O2 \
+    -Isrc \
+    -Iinclude \
+    -pthread \
+    src/bench/memsim_bench.cpp \
+    src/simulator/simulator.cpp \
+    src/stats/stats_registry.cpp \
+    src/profile/profiler.cpp \
+    src/io/output.cpp \
+    src/trace/trace_format.cpp \
+    src/trace/trace_writer.cpp \
+    src/trace/trace_reader.cpp \
+    src/trace/alloc_import.cpp \
+    src/allocator/memory_manager.cpp \
+    src/cache/cache.cpp \
+    src/virtual_memory/VirtualMemory.cpp \
+    src/virtual_memory/TLB.cpp \
+    src/virtual_memory/TieredMemory.cpp \
+    src/virtual_memory/BackingStore.cpp \
+    src/buddy/buddy_allocator.cpp \
+    src/workload/workload_generator.cpp \
+    src/checkpoint/checkpoint.cpp \
+    src/attribution/miss_attribution.cpp \
+    src/qos/bandwidth_throttle.cpp \
+    src/arena/arena.cpp \
+    -o memsim_bench
+
+echo "✔ Compilation successful: memsim_bench created"
+
+# Allocation recorder for LD_PRELOAD (Linux only)
+if [ "$(uname -s)" = "Linux" ]; then
+    g++ -std=gnu++20 -O2 -fPIC -shared \
+        -Isrc \
+        src/preload/malloc_recorder.cpp \
+        -o libmemsim_record.so \
+        -ldl -pthread
+    echo "✔ Compilation successful: libmemsim_record.so created"
+
+    # Allocation policies over a real mmap'd arena: C API and malloc shim
+    ARENA_SOURCES="src/arena/arena.cpp \
+        src/allocator/memory_manager.cpp \
+        src/buddy/buddy_allocator.cpp \
+        src/checkpoint/checkpoint.cpp \
+        src/io/output.cpp"
+
+    g++ -std=gnu++20 -O2 -fPIC -shared \
+        -Isrc \
+        -Iinclude \
+        src/arena/memsim_arena.cpp \
+        $ARENA_SOURCES \
+        -o libmemsim_arena.so
+    echo "✔ Compilation successful: libmemsim_arena.so created"
+
+    g++ -std=gnu++20 -O2 -fPIC -shared \
+        -Isrc \
+        src/preload/malloc_shim.cpp \
+        $ARENA_SOURCES \
+        -o libmemsim_malloc.so \
+        -ldl -pthread
+    echo "✔ Compilation successful: libmemsim_malloc.so created"
+fi
+
 # -------------------------------------------------
 # Step 3: Final message
 # -------------------------------------------------
@@ -80,6 +178,12 @@ echo "----------------------------------------"
 echo "Run simulator manually:"
 echo "  ./memsim"
 echo ""
+echo "Record allocations of a program (Linux):"
+echo "  MEMSIM_ALLOC_TRACE=app.alloc LD_PRELOAD=./libmemsim_record.so ./app"
+echo ""
+echo "Run microbenchmarks (JSON lines, --csv for CSV):"
+echo "  ./memsim_bench --quick > bench_output.txt"
+echo ""
 echo "Run all tests:"
 echo "  ./run_tests.sh"
 echo "----------------------------------------"
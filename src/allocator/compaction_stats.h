@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// What started a compaction
+enum class CompactionTrigger {
+    MANUAL,
+    ALLOC_FAILURE,
+    FRAGMENTATION
+};
+
+// Modelled cost of sliding blocks: a fixed cost per moved block for
+// fixing up references, plus the copy itself
+const size_t COMPACT_BLOCK_CYCLES = 20;
+const size_t COMPACT_BYTES_PER_CYCLE = 8;
+
+// Per-pass events kept for "compact history"; totals keep counting after
+const size_t COMPACT_HISTORY_LIMIT = 4096;
+
+// One compaction pass (full, or one incremental step)
+struct CompactionEvent {
+    CompactionTrigger trigger;
+    bool incremental;
+    size_t blocks_moved;
+    size_t bytes_moved;
+    size_t pause_cycles;
+};
+
+struct CompactionStats {
+    size_t compactions = 0;
+    size_t incremental_steps = 0;
+    size_t blocks_moved = 0;
+    size_t bytes_moved = 0;
+    size_t total_pause = 0;         // cycles
+    size_t max_pause = 0;
+    size_t failure_triggers = 0;
+    size_t failures_avoided = 0;    // allocations that succeeded after compacting
+    size_t threshold_triggers = 0;
+    CompactionEvent last {};
+    std::vector<CompactionEvent> history;
+
+    bool used() const { return compactions > 0; }
+
+    void record(const CompactionEvent& event) {
+        compactions++;
+        if (event.incremental)
+            incremental_steps++;
+        if (event.trigger == CompactionTrigger::ALLOC_FAILURE)
+            failure_triggers++;
+        else if (event.trigger == CompactionTrigger::FRAGMENTATION)
+            threshold_triggers++;
+
+        blocks_moved += event.blocks_moved;
+        bytes_moved += event.bytes_moved;
+        total_pause += event.pause_cycles;
+        if (event.pause_cycles > max_pause)
+            max_pause = event.pause_cycles;
+        last = event;
+        if (history.size() < COMPACT_HISTORY_LIMIT)
+            history.push_back(event);
+    }
+
+    void print(std::ostream& out) const {
+        out << "Compactions: " << compactions
+            << " (" << incremental_steps << " incremental)\n";
+        out << "  triggered by failure/threshold: " << failure_triggers
+            << "/" << threshold_triggers
+            << ", failures avoided: " << failures_avoided << "\n";
+        out << "  blocks moved: " << blocks_moved
+            << ", bytes moved: " << bytes_moved << "\n";
+        out << "  pause cycles total/avg/max: " << total_pause << "/"
+            << total_pause / compactions << "/" << max_pause << "\n";
+    }
+};
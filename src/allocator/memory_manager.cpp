@@ -1,6 +1,11 @@
 #include "memory_manager.h"
 #include <iostream>
 #include <iomanip>
+#include "../io/output.h"
+#include "../profile/profiler.h"
+#include "../checkpoint/checkpoint.h"
+#include <algorithm>
+#include <unordered_set>
 using namespace std;
 
 MemoryManager::MemoryManager():
@@ -10,7 +15,14 @@ MemoryManager::MemoryManager():
       total_requests(0),
       successful_allocs(0),
       failed_allocs(0),
-      buddy(0) 
+      buddy(0),
+      compact_on_failure(false),
+      compact_threshold(0.0),
+      compact_budget(0),
+      free_bytes(0),
+      used_bytes(0),
+      used_blocks(0),
+      internal_frag(0)
 {}
 
 void MemoryManager::init_memory(size_t total_size) {
@@ -22,13 +34,29 @@ void MemoryManager::init_memory(size_t total_size) {
     initial.size = total_size;
     initial.free = true;
     initial.block_id = -1;
+    initial.requested = 0;
+    initial.padding = 0;
+    initial.align = 1;
     total_requests = 0;
     successful_allocs = 0;
     failed_allocs = 0;
     next_block_id = 1;
+    realloc_stats = ReallocStats();
+    compaction_stats = CompactionStats();
+    relocations.clear();
+    compact_from = 0;
+
+    free_sizes.clear();
+    used_index.clear();
+    used_starts.clear();
+    free_bytes = 0;
+    used_bytes = 0;
+    used_blocks = 0;
+    internal_frag = 0;
 
     buddy.init(total_size);
     blocks.push_back(initial);
+    track_free(total_size);
 }
 
 void MemoryManager::set_allocator(AllocatorType type) {
@@ -36,25 +64,27 @@ void MemoryManager::set_allocator(AllocatorType type) {
 }
 
 void MemoryManager::dump_memory() const {
-    cout << "Allocator = " << (int)allocator_type << "\n";
+    std::ostream& out = Output::stream();
+
+    out << "Allocator = " << (int)allocator_type << "\n";
 
     if (allocator_type == AllocatorType::BUDDY) {
         size_t used = buddy.get_used_memory();
         size_t total = buddy.get_total_memory();
 
-        cout << "Allocation requests: "
+        out << "Allocation requests: "
             << buddy.get_successful_allocs() + buddy.get_failed_allocs() << "\n";
-        cout << "Successful allocations: "
+        out << "Successful allocations: "
             << buddy.get_successful_allocs() << "\n";
-        cout << "Failed allocations: "
+        out << "Failed allocations: "
             << buddy.get_failed_allocs() << "\n";
 
-        cout << "Total memory: " << total << " bytes\n";
-        cout << "Used memory: " << used << " bytes\n";
-        cout << "Free memory: " << (total - used) << " bytes\n";
+        out << "Total memory: " << total << " bytes\n";
+        out << "Used memory: " << used << " bytes\n";
+        out << "Free memory: " << (total - used) << " bytes\n";
 
         double util = (double)used / total * 100.0;
-        cout << "Utilization: " << util << "%\n";
+        out << "Utilization: " << util << "%\n";
         return;
     }
 
@@ -62,178 +92,627 @@ void MemoryManager::dump_memory() const {
     size_t used_blocks = 0;
     size_t largest_free = 0;
 
-    cout << "===== Memory Layout =====\n";
+    out << "===== Memory Layout =====\n";
 
     for (const auto& block : blocks) {
         size_t end = block.start + block.size - 1;
 
-        cout << "[0x"
-             << setw(4) << setfill('0') << hex << block.start
-             << " - 0x"
-             << setw(4) << setfill('0') << hex << end
-             << "] ";
+        out << "[0x"
+            << setw(4) << setfill('0') << hex << block.start
+            << " - 0x"
+            << setw(4) << setfill('0') << hex << end
+            << "] ";
 
-        cout << dec;
+        out << dec;
 
         if (block.free) {
-            cout << "FREE   ";
+            out << "FREE   ";
             free_blocks++;
             largest_free = max(largest_free, block.size);
         } else {
-            cout << "USED   id=" << block.block_id << " ";
+            out << "USED   id=" << block.block_id << " ";
             used_blocks++;
         }
 
-        cout << "size=" << block.size << " bytes\n";
+        out << "size=" << block.size << " bytes\n";
     }
 
-    cout << "-----------------------------\n";
-    cout << "Total blocks: " << blocks.size() << "\n";
-    cout << "Used blocks : " << used_blocks << "\n";
-    cout << "Free blocks : " << free_blocks << "\n";
-    cout << "Largest free block: " << largest_free << " bytes\n";
+    out << "-----------------------------\n";
+    out << "Total blocks: " << blocks.size() << "\n";
+    out << "Used blocks : " << used_blocks << "\n";
+    out << "Free blocks : " << free_blocks << "\n";
+    out << "Largest free block: " << largest_free << " bytes\n";
 }
 
 bool MemoryManager::free_block(int block_id) {
+    MEMSIM_PROBE(FREE);
     if (allocator_type == AllocatorType::BUDDY) {
         bool success = buddy.free_block(block_id);
         return success;
     }
-    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-
-        if (!it->free && it->block_id == block_id) {
 
-            // Step 1: mark as free
-            it->free = true;
-            it->block_id = -1;
+    auto it = find_used_block(block_id);
+    if (it == blocks.end())
+        return false; // block id not found
 
-            // Step 2: coalesce with previous
-            if (it != blocks.begin()) {
-                auto prev = std::prev(it);
-                if (prev->free) {
-                    prev->size += it->size;
-                    it = blocks.erase(it);
-                    it = prev;
-                }
-            }
+    release_block(it);
 
-            // Step 3: coalesce with next
-            auto next = std::next(it);
-            if (next != blocks.end() && next->free) {
-                it->size += next->size;
-                blocks.erase(next);
-            }
+    if (compact_threshold > 0 && external_fragmentation() >= compact_threshold) {
+        if (compact_budget > 0)
+            compact_step(compact_budget, CompactionTrigger::FRAGMENTATION);
+        else
+            compact(CompactionTrigger::FRAGMENTATION);
+    }
+    return true;
+}
 
-            return true;
+void MemoryManager::release_block(list<Block>::iterator it) {
+    // Step 1: mark as free
+    untrack_used(*it);
+    // A relocated block has already been re-indexed at its new place
+    auto indexed = used_index.find(it->block_id);
+    if (indexed != used_index.end() && indexed->second == it)
+        used_index.erase(indexed);
+    auto start = used_starts.find(it->start);
+    if (start != used_starts.end() && start->second == it->block_id)
+        used_starts.erase(start);
+    it->free = true;
+    it->block_id = -1;
+    it->padding = 0;
+    it->align = 1;
+
+    // Step 2: coalesce with previous
+    if (it != blocks.begin()) {
+        auto prev = std::prev(it);
+        if (prev->free) {
+            untrack_free(prev->size);
+            prev->size += it->size;
+            it = blocks.erase(it);
+            it = prev;
         }
     }
 
-    return false; // block id not found
+    // Step 3: coalesce with next
+    auto next = std::next(it);
+    if (next != blocks.end() && next->free) {
+        untrack_free(next->size);
+        it->size += next->size;
+        blocks.erase(next);
+    }
+    track_free(it->size);
+    mark_hole(it->start);
 }
 
-int MemoryManager::malloc_block(size_t size) {
+list<Block>::iterator MemoryManager::find_used_block(int block_id) {
+    auto found = used_index.find(block_id);
+    if (found == used_index.end())
+        return blocks.end();
+    return found->second;
+}
 
+// Picks a free block by the current policy. padding is set to the bytes
+// needed in front of the payload to reach the requested alignment.
+list<Block>::iterator MemoryManager::find_free_block(size_t size, size_t align,
+                                                     size_t& padding) {
     auto selected = blocks.end();
-    total_requests++;
-
-    if (allocator_type == AllocatorType::BUDDY) {
-            int addr = buddy.malloc_block(size);
-            if (addr == -1) {
-                failed_allocs++;
-                return -1;
-            } else {
-                successful_allocs++;
-                return addr; // in Buddy, addr acts as block id
-            }
-        }
+    size_t selected_padding = 0;
 
     for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-        if (!it->free || it->size < size)
+        MEMSIM_COUNT(LIST_NODES_VISITED, 1);
+        if (!it->free)
+            continue;
+
+        size_t pad = (align - it->start % align) % align;
+        if (it->size < size + pad)
             continue;
 
         if (allocator_type == AllocatorType::FIRST_FIT) {
             selected = it;
+            selected_padding = pad;
             break;
         }
         
-        if (selected == blocks.end()) {
-            selected = it;
-        } else if (allocator_type == AllocatorType::BEST_FIT &&
-                   it->size < selected->size) {
-            selected = it;
-        } else if (allocator_type == AllocatorType::WORST_FIT &&
-                   it->size > selected->size) {
+        if (selected == blocks.end() ||
+            (allocator_type == AllocatorType::BEST_FIT &&
+             it->size < selected->size) ||
+            (allocator_type == AllocatorType::WORST_FIT &&
+             it->size > selected->size)) {
             selected = it;
+            selected_padding = pad;
         }
     }
 
-    if (selected == blocks.end()){
-        failed_allocs++;
-        return -1;
-    }
-        
-    int allocated_id = next_block_id++;
+    padding = selected_padding;
+    return selected;
+}
 
-    if (selected->size == size) {
+// Carves size + padding bytes off the front of a free block
+void MemoryManager::place_block(list<Block>::iterator selected, size_t size,
+                                size_t padding, size_t align, int block_id) {
+    size_t total = size + padding;
+    untrack_free(selected->size);
+
+    if (selected->size == total) {
         selected->free = false;
-        selected->block_id = allocated_id;
+        selected->block_id = block_id;
         selected->requested = size;  
+        selected->padding = padding;
+        selected->align = align;
+        used_index[block_id] = selected;
+        used_starts[selected->start] = block_id;
     } else {
         Block allocated {
             selected->start,
-            size,
+            total,
             size,
             false,
-            allocated_id
+            block_id,
+            padding,
+            align
         };
 
-        selected->start += size;
-        selected->size -= size;
+        selected->start += total;
+        selected->size -= total;
+        track_free(selected->size);
+
+        used_index[block_id] = blocks.insert(selected, allocated);
+        used_starts[allocated.start] = block_id;
+    }
+    track_used(size + padding, size);
+}
+
+int MemoryManager::malloc_block(size_t size) {
+    MEMSIM_PROBE(MALLOC);
+
+    total_requests++;
+
+    if (allocator_type == AllocatorType::BUDDY) {
+            int addr = buddy.malloc_block(size);
+            if (addr == -1) {
+                failed_allocs++;
+                return -1;
+            } else {
+                successful_allocs++;
+                return addr; // in Buddy, addr acts as block id
+            }
+        }
+
+    int allocated_id = allocate(size, 1);
+    if (allocated_id == -1) {
+        failed_allocs++;
+        return -1;
+    }
+
+    successful_allocs++;
+    return allocated_id;
+}
+
+// Finds and carves out a block for the list allocators, compacting
+// first if that is the only way the request can fit
+int MemoryManager::allocate(size_t size, size_t align) {
+    size_t padding;
+    auto selected = find_free_block(size, align, padding);
+
+    if (selected == blocks.end() && compact_on_failure &&
+        free_bytes >= size + align - 1) {
+        compact(CompactionTrigger::ALLOC_FAILURE);
+        selected = find_free_block(size, align, padding);
+        if (selected != blocks.end())
+            compaction_stats.failures_avoided++;
+    }
+
+    if (selected == blocks.end())
+        return -1;
+
+    int allocated_id = next_block_id++;
+    place_block(selected, size, padding, align, allocated_id);
+    realloc_stats.alignment_padding += padding;
+    return allocated_id;
+}
+
+int MemoryManager::malloc_aligned(size_t size, size_t align) {
+    if (align == 0 || (align & (align - 1)) != 0)
+        return -1;
+
+    total_requests++;
+    realloc_stats.aligned_requests++;
+
+    if (allocator_type == AllocatorType::BUDDY) {
+        int addr = buddy.malloc_aligned(size, align);
+        if (addr == -1) {
+            failed_allocs++;
+            return -1;
+        }
+        successful_allocs++;
+        return addr;
+    }
 
-        blocks.insert(selected, allocated);
+    int allocated_id = allocate(size, align);
+    if (allocated_id == -1) {
+        failed_allocs++;
+        return -1;
     }
 
     successful_allocs++;
     return allocated_id;
 }
 
+// Gives the tail beyond padding + new_size back to the free list
+void MemoryManager::shrink_block(list<Block>::iterator it, size_t new_size) {
+    size_t tail = it->size - it->padding - new_size;
+    untrack_used(*it);
+    it->requested = new_size;
+    it->size -= tail;
+    track_used(it->size, it->requested);
+    if (tail == 0)
+        return;
+
+    auto next = std::next(it);
+    if (next != blocks.end() && next->free) {
+        untrack_free(next->size);
+        next->start -= tail;
+        next->size += tail;
+        track_free(next->size);
+    } else {
+        Block hole {it->start + it->size, tail, 0, true, -1, 0, 1};
+        blocks.insert(next, hole);
+        track_free(tail);
+    }
+    mark_hole(it->start + it->size);
+}
+
+// Extends a used block into the free block right after it
+bool MemoryManager::grow_in_place(list<Block>::iterator it, size_t new_size) {
+    size_t needed = new_size - (it->size - it->padding);
+    auto next = std::next(it);
+    if (next == blocks.end() || !next->free || next->size < needed)
+        return false;
+
+    untrack_used(*it);
+    untrack_free(next->size);
+    it->size += needed;
+    it->requested = new_size;
+    next->start += needed;
+    next->size -= needed;
+    track_used(it->size, it->requested);
+    if (next->size == 0)
+        blocks.erase(next);
+    else
+        track_free(next->size);
+    return true;
+}
+
+// Moves a used block down into the free block before it, together with
+// the free block after it if there is one. The payload is copied, but
+// no other free block is needed and no hole is left behind.
+bool MemoryManager::grow_into_previous(list<Block>::iterator it, size_t new_size) {
+    if (it == blocks.begin())
+        return false;
+    auto prev = std::prev(it);
+    auto next = std::next(it);
+    if (!prev->free)
+        return false;
+
+    bool with_next = next != blocks.end() && next->free;
+    size_t span = prev->size + it->size + (with_next ? next->size : 0);
+    size_t pad = (it->align - prev->start % it->align) % it->align;
+    if (span < pad + new_size)
+        return false;
+
+    untrack_used(*it);
+    untrack_free(prev->size);
+    if (with_next) {
+        untrack_free(next->size);
+        blocks.erase(next);
+    }
+    auto start = used_starts.find(it->start);
+    if (start != used_starts.end() && start->second == it->block_id)
+        used_starts.erase(start);
+
+    it->start = prev->start;
+    it->padding = pad;
+    it->requested = new_size;
+    it->size = pad + new_size;
+    used_starts[it->start] = it->block_id;
+    track_used(it->size, it->requested);
+    blocks.erase(prev);
+
+    size_t tail = span - it->size;
+    if (tail > 0) {
+        Block hole {it->start + it->size, tail, 0, true, -1, 0, 1};
+        blocks.insert(std::next(it), hole);
+        track_free(tail);
+        mark_hole(hole.start);
+    }
+    return true;
+}
+
+int MemoryManager::realloc_block(int block_id, size_t new_size) {
+    // realloc(p, 0) frees, as in C
+    if (new_size == 0) {
+        free_block(block_id);
+        return -1;
+    }
+
+    if (allocator_type == AllocatorType::BUDDY)
+        return buddy.realloc_block(block_id, new_size);
+
+    auto it = find_used_block(block_id);
+    if (it == blocks.end())
+        return -1;
+
+    realloc_stats.realloc_requests++;
+    size_t old_size = it->requested;
+    size_t capacity = it->size - it->padding;
+
+    // Shrink (or same size): split the tail off in place
+    if (new_size <= capacity) {
+        shrink_block(it, new_size);
+        realloc_stats.in_place_shrinks++;
+        realloc_stats.bytes_copy_avoided += new_size;
+        return block_id;
+    }
+
+    // Grow into the free block right after this one, else slide down
+    // over the free neighbours
+    bool in_place = grow_in_place(it, new_size);
+    if (!in_place && grow_into_previous(it, new_size)) {
+        realloc_stats.relocations++;
+        realloc_stats.bytes_copied += old_size;
+        return block_id;
+    }
+    size_t padding = 0;
+    auto selected = blocks.end();
+    if (!in_place)
+        selected = find_free_block(new_size, it->align, padding);
+
+    if (!in_place && selected == blocks.end() && compact_on_failure) {
+        // Block iterators survive compaction; only free blocks are erased
+        compact(CompactionTrigger::ALLOC_FAILURE);
+        in_place = grow_in_place(it, new_size);
+        if (!in_place)
+            selected = find_free_block(new_size, it->align, padding);
+        if (in_place || selected != blocks.end())
+            compaction_stats.failures_avoided++;
+    }
+
+    if (in_place) {
+        realloc_stats.in_place_grows++;
+        realloc_stats.bytes_copy_avoided += old_size;
+        return block_id;
+    }
+
+    // Relocate: the id stays, the payload is copied
+    if (selected == blocks.end()) {
+        realloc_stats.failed_reallocs++;
+        return -1;
+    }
+
+    place_block(selected, new_size, padding, it->align, block_id);
+    release_block(it);
+
+    realloc_stats.relocations++;
+    realloc_stats.bytes_copied += old_size;
+    return block_id;
+}
+
+size_t MemoryManager::compact(CompactionTrigger trigger) {
+    return slide_blocks(0, trigger);
+}
+
+size_t MemoryManager::compact_step(size_t move_budget, CompactionTrigger trigger) {
+    return slide_blocks(move_budget, trigger);
+}
+
+// The block at compact_from, or the first block after it. Everything
+// before it is used and packed; cursor is set to where it ends.
+list<Block>::iterator MemoryManager::first_uncompacted(size_t& cursor) {
+    auto it = blocks.end();
+    auto used = used_starts.lower_bound(compact_from);
+    if (used != used_starts.end())
+        it = used_index[used->second];
+    // Adjacent free blocks are merged, so at most one lies in between
+    if (it != blocks.begin() && std::prev(it)->free && std::prev(it)->start >= compact_from)
+        --it;
+
+    cursor = 0;
+    if (it != blocks.begin()) {
+        auto prev = std::prev(it);
+        cursor = prev->start + prev->size;
+    }
+    return it;
+}
+
+// Sliding compaction: used blocks keep their order and move down to the
+// lowest address their alignment allows. With a budget the pass stops
+// once that many bytes have moved; everything below the stop point is
+// already compact, so the next pass picks up from there. Either way a
+// pass starts at the lowest hole, not at the start of the heap.
+size_t MemoryManager::slide_blocks(size_t move_budget, CompactionTrigger trigger) {
+    relocations.clear();
+    if (allocator_type == AllocatorType::BUDDY)
+        return 0;
+
+    size_t cursor;
+    size_t bytes_moved = 0;
+    size_t blocks_moved = 0;
+
+    auto it = first_uncompacted(cursor);
+    while (it != blocks.end()) {
+        if (it->free) {
+            untrack_free(it->size);
+            it = blocks.erase(it);
+            continue;
+        }
+
+        size_t padding = (it->align - cursor % it->align) % it->align;
+        if (cursor != it->start) {
+            if (move_budget > 0 && bytes_moved >= move_budget)
+                break;
+
+            untrack_used(*it);
+            used_starts.erase(it->start);
+            used_starts[cursor] = it->block_id;
+            it->start = cursor;
+            it->padding = padding;
+            it->size = padding + it->requested;
+            track_used(it->size, it->requested);
+            relocations[it->block_id] = it->start + it->padding;
+
+            blocks_moved++;
+            bytes_moved += it->requested;
+        }
+
+        cursor = it->start + it->size;
+        ++it;
+    }
+
+    // Whatever lies between the cursor and the next unmoved block
+    // (or the end of memory) becomes one free region
+    size_t hole_end = (it == blocks.end()) ? total_memory : it->start;
+    if (hole_end > cursor) {
+        Block hole {cursor, hole_end - cursor, 0, true, -1, 0, 1};
+        blocks.insert(it, hole);
+        track_free(hole.size);
+    }
+    compact_from = cursor;
+
+    CompactionEvent event {
+        trigger,
+        move_budget > 0,
+        blocks_moved,
+        bytes_moved,
+        blocks_moved * COMPACT_BLOCK_CYCLES + bytes_moved / COMPACT_BYTES_PER_CYCLE
+    };
+    compaction_stats.record(event);
+    return bytes_moved;
+}
+
+void MemoryManager::set_compaction_threshold(double threshold, size_t budget) {
+    compact_threshold = threshold;
+    compact_budget = budget;
+}
+
+void MemoryManager::track_free(size_t size) {
+    free_sizes.insert(size);
+    free_bytes += size;
+}
+
+void MemoryManager::untrack_free(size_t size) {
+    free_sizes.erase(free_sizes.find(size));
+    free_bytes -= size;
+}
+
+void MemoryManager::track_used(size_t size, size_t requested) {
+    used_bytes += size;
+    used_blocks++;
+    internal_frag += size - requested;
+}
+
+void MemoryManager::untrack_used(const Block& block) {
+    used_bytes -= block.size;
+    used_blocks--;
+    internal_frag -= block.size - block.requested;
+}
+
+long long MemoryManager::block_start(int block_id) const {
+    if (allocator_type == AllocatorType::BUDDY)
+        return buddy.is_allocated(block_id) ? block_id : -1;
+
+    auto found = used_index.find(block_id);
+    if (found == used_index.end())
+        return -1;
+    return found->second->start + found->second->padding;
+}
+
+int MemoryManager::block_at(size_t address) const {
+    if (allocator_type == AllocatorType::BUDDY)
+        return (int)buddy.block_at(address);
+
+    // The last block starting at or below address, if it reaches it
+    auto found = used_starts.upper_bound(address);
+    if (found == used_starts.begin())
+        return -1;
+    --found;
+    const Block& block = *used_index.at(found->second);
+    return address < block.start + block.size ? block.block_id : -1;
+}
+
+size_t MemoryManager::block_size(int block_id) const {
+    if (allocator_type == AllocatorType::BUDDY)
+        return buddy.requested_size(block_id);
+
+    auto found = used_index.find(block_id);
+    return found == used_index.end() ? 0 : found->second->requested;
+}
+
+size_t MemoryManager::get_used_memory() const {
+    if (allocator_type == AllocatorType::BUDDY)
+        return buddy.get_used_memory();
+    return used_bytes;
+}
+
+size_t MemoryManager::get_free_memory() const {
+    if (allocator_type == AllocatorType::BUDDY)
+        return buddy.get_total_memory() - buddy.get_used_memory();
+    return free_bytes;
+}
+
+size_t MemoryManager::get_largest_free() const {
+    if (allocator_type == AllocatorType::BUDDY)
+        return buddy.get_largest_free();
+    return free_sizes.empty() ? 0 : *free_sizes.rbegin();
+}
+
+size_t MemoryManager::get_internal_fragmentation() const {
+    if (allocator_type == AllocatorType::BUDDY)
+        return buddy.get_internal_fragmentation();
+    return internal_frag;
+}
+
+double MemoryManager::external_fragmentation() const {
+    size_t free = get_free_memory();
+    if (free == 0)
+        return 0.0;
+    return (1.0 - (double)get_largest_free() / free) * 100.0;
+}
+
+void MemoryManager::print_compaction_history() const {
+    std::ostream& out = Output::stream();
+    static const char* triggers[] = {"manual", "alloc failure", "fragmentation"};
+
+    size_t n = 1;
+    for (const auto& event : compaction_stats.history) {
+        out << "#" << n++ << " " << triggers[(int)event.trigger]
+            << (event.incremental ? " (incremental)" : "") << ": "
+            << event.blocks_moved << " blocks, "
+            << event.bytes_moved << " bytes, "
+            << event.pause_cycles << " cycles\n";
+    }
+}
+
 void MemoryManager::print_stats() const {
+    std::ostream& out = Output::stream();
 
     if (allocator_type == AllocatorType::BUDDY) {
         buddy.print_stats();
 
         return;  
     }
-    
-    size_t used = 0;
-    size_t free = 0;
-    size_t largest_free = 0;
-    size_t internal_frag = 0;
 
-    cout << "Allocation requests: " << total_requests << "\n";
-    cout << "Successful allocations: " << successful_allocs << "\n";
-    cout << "Failed allocations: " << failed_allocs << "\n";
+    out << "Allocation requests: " << total_requests << "\n";
+    out << "Successful allocations: " << successful_allocs << "\n";
+    out << "Failed allocations: " << failed_allocs << "\n";
 
     if (total_requests > 0) {
         double success_rate =
             (double)successful_allocs / total_requests * 100.0;
-        cout << "Allocation success rate: "
-                << success_rate << "%\n";
+        out << "Allocation success rate: "
+            << success_rate << "%\n";
     }
 
-    for (const auto& block : blocks) {
-        if (block.free) {
-            free += block.size;
-            if (block.size > largest_free)
-                largest_free = block.size;
-        } else {
-            used += block.size;
-            internal_frag += (block.size - block.requested);
-            cout << "Internal fragmentation: "
-            << internal_frag << " bytes\n";
-
-        }
-    }
+    out << "Internal fragmentation: "
+        << internal_frag << " bytes\n";
 
     double failure_rate = 0;
     if (total_requests > 0) {
@@ -241,22 +720,186 @@ void MemoryManager::print_stats() const {
             (double)failed_allocs / total_requests * 100.0;
     }
 
-    cout << "Allocation failure rate: "
+    out << "Allocation failure rate: "
         << failure_rate << "%\n";
 
 
-    double utilization = (double)used / total_memory * 100.0;
+    double utilization = (double)used_bytes / total_memory * 100.0;
+
+    out << "Total memory: " << total_memory << " bytes\n";
+    out << "Used memory: " << used_bytes << " bytes\n";
+    out << "Free memory: " << free_bytes << " bytes\n";
+    out << "Utilization: " << utilization << "%\n";
+    out << "External fragmentation: "
+        << external_fragmentation() << "%\n";
 
-    double external_fragmentation = 0.0;
-    if (free > 0) {
-        external_fragmentation =
-            (1.0 - (double)largest_free / free) * 100.0;
+    if (realloc_stats.used())
+        realloc_stats.print(out);
+    if (compaction_stats.used())
+        compaction_stats.print(out);
+}
+
+// Scalar state of a checkpoint; the block list and the derived totals are
+// saved and rebuilt separately
+struct MemoryCheckpoint {
+    size_t total_memory;
+    int next_block_id;
+    AllocatorType allocator_type;
+    size_t total_requests;
+    size_t successful_allocs;
+    size_t failed_allocs;
+    ReallocStats realloc_stats;
+    bool compact_on_failure;
+    double compact_threshold;
+    size_t compact_budget;
+
+    size_t compactions;
+    size_t incremental_steps;
+    size_t blocks_moved;
+    size_t bytes_moved;
+    size_t total_pause;
+    size_t max_pause;
+    size_t failure_triggers;
+    size_t failures_avoided;
+    size_t threshold_triggers;
+    CompactionEvent last;
+};
+
+struct RelocationRecord {
+    int block_id;
+    size_t start;
+};
+
+void MemoryManager::save(CheckpointWriter& out) const {
+    const CompactionStats& c = compaction_stats;
+    MemoryCheckpoint state {
+        total_memory, next_block_id, allocator_type,
+        total_requests, successful_allocs, failed_allocs, realloc_stats,
+        compact_on_failure, compact_threshold, compact_budget,
+        c.compactions, c.incremental_steps, c.blocks_moved, c.bytes_moved,
+        c.total_pause, c.max_pause, c.failure_triggers, c.failures_avoided,
+        c.threshold_triggers, c.last
+    };
+    out.add_value(SectionId::MEMORY_STATE, state);
+
+    vector<Block> list_blocks(blocks.begin(), blocks.end());
+    out.add(SectionId::MEMORY_BLOCKS, list_blocks);
+
+    vector<RelocationRecord> moved;
+    for (const auto& [id, start] : relocations)
+        moved.push_back({id, start});
+    out.add(SectionId::MEMORY_RELOCATIONS, moved);
+    out.add(SectionId::COMPACTION_HISTORY, c.history);
+
+    buddy.save(out);
+}
+
+// The sections of a heap checkpoint, found but not applied yet
+struct MemorySections {
+    MemoryCheckpoint state;
+    const Block* blocks = nullptr;
+    const RelocationRecord* moved = nullptr;
+    const CompactionEvent* history = nullptr;
+    size_t block_count = 0, moved_count = 0, history_count = 0;
+
+    bool read(const CheckpointReader& in);
+    bool valid() const;
+};
+
+bool MemorySections::read(const CheckpointReader& in) {
+    blocks = in.get<Block>(SectionId::MEMORY_BLOCKS, block_count);
+    moved = in.get<RelocationRecord>(SectionId::MEMORY_RELOCATIONS, moved_count);
+    history = in.get<CompactionEvent>(SectionId::COMPACTION_HISTORY, history_count);
+    return in.get_value(SectionId::MEMORY_STATE, state) && blocks && moved && history
+        && valid();
+}
+
+// The blocks tile the heap from address 0, and each used block holds
+// its padding and payload under a distinct id
+bool MemorySections::valid() const {
+    if ((int)state.allocator_type < (int)AllocatorType::FIRST_FIT ||
+        (int)state.allocator_type > (int)AllocatorType::BUDDY)
+        return false;
+
+    std::unordered_set<int> ids;
+    size_t end = 0;
+    for (size_t i = 0; i < block_count; i++) {
+        const Block& b = blocks[i];
+        if (b.start != end || b.size > state.total_memory - end ||
+            (b.size == 0 && state.total_memory > 0))
+            return false;
+        end += b.size;
+        if (b.free)
+            continue;
+        if (b.padding > b.size || b.requested > b.size - b.padding ||
+            b.align == 0 || (b.align & (b.align - 1)) != 0 ||
+            b.block_id <= 0 || b.block_id >= state.next_block_id ||
+            !ids.insert(b.block_id).second)
+            return false;
     }
+    return end == state.total_memory;
+}
 
-    cout << "Total memory: " << total_memory << " bytes\n";
-    cout << "Used memory: " << used << " bytes\n";
-    cout << "Free memory: " << free << " bytes\n";
-    cout << "Utilization: " << utilization << "%\n";
-    cout << "External fragmentation: "
-              << external_fragmentation << "%\n";
+bool MemoryManager::can_load(const CheckpointReader& in) const {
+    MemorySections saved;
+    return saved.read(in) && buddy.can_load(in);
+}
+
+bool MemoryManager::load(const CheckpointReader& in) {
+    MemorySections saved;
+    if (!saved.read(in) || !buddy.load(in))
+        return false;
+
+    const MemoryCheckpoint& state = saved.state;
+
+    total_memory = state.total_memory;
+    next_block_id = state.next_block_id;
+    allocator_type = state.allocator_type;
+    total_requests = state.total_requests;
+    successful_allocs = state.successful_allocs;
+    failed_allocs = state.failed_allocs;
+    realloc_stats = state.realloc_stats;
+    compact_on_failure = state.compact_on_failure;
+    compact_threshold = state.compact_threshold;
+    compact_budget = state.compact_budget;
+
+    CompactionStats& c = compaction_stats;
+    c.compactions = state.compactions;
+    c.incremental_steps = state.incremental_steps;
+    c.blocks_moved = state.blocks_moved;
+    c.bytes_moved = state.bytes_moved;
+    c.total_pause = state.total_pause;
+    c.max_pause = state.max_pause;
+    c.failure_triggers = state.failure_triggers;
+    c.failures_avoided = state.failures_avoided;
+    c.threshold_triggers = state.threshold_triggers;
+    c.last = state.last;
+    c.history.assign(saved.history, saved.history + saved.history_count);
+
+    relocations.clear();
+    for (size_t i = 0; i < saved.moved_count; i++)
+        relocations[saved.moved[i].block_id] = saved.moved[i].start;
+
+    blocks.assign(saved.blocks, saved.blocks + saved.block_count);
+
+    // Running totals and the id index are derived from the list
+    free_sizes.clear();
+    used_index.clear();
+    used_starts.clear();
+    free_bytes = 0;
+    used_bytes = 0;
+    used_blocks = 0;
+    internal_frag = 0;
+    compact_from = total_memory;
+    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+        if (it->free) {
+            track_free(it->size);
+            mark_hole(it->start);
+        } else {
+            track_used(it->size, it->requested);
+            used_index[it->block_id] = it;
+            used_starts[it->start] = it->block_id;
+        }
+    }
+    return true;
 }
@@ -1,15 +1,25 @@
 #pragma once
 #include "../buddy/buddy_allocator.h" 
+#include "realloc_stats.h"
+#include "compaction_stats.h"
 #include <list>
 #include <cstddef>
+#include <map>
+#include <set>
+#include <unordered_map>
 using namespace std;
 
+class CheckpointWriter;
+class CheckpointReader;
+
 struct Block {
     size_t start;
     size_t size;
     size_t requested;   
     bool free;
     int block_id;
+    size_t padding;     // alignment bytes in front of the payload
+    size_t align;       // payload alignment, kept when compaction moves it
 };
 
 enum class AllocatorType {
@@ -25,12 +35,69 @@ public:
 
     void init_memory(size_t total_size);
     void set_allocator(AllocatorType type);
+    AllocatorType get_allocator() const { return allocator_type; }
 
     int malloc_block(size_t size);
     bool free_block(int block_id);
 
+    // align must be a power of two; returns the block id or -1
+    int malloc_aligned(size_t size, size_t align);
+    // Grows or shrinks a block, in place when the neighbouring space
+    // allows it. Returns the (possibly new, for buddy) id, or -1 with the
+    // block left untouched. A new size of 0 frees the block.
+    int realloc_block(int block_id, size_t new_size);
+
+    // Address of a live block's payload, or -1. O(1); follows compaction.
+    long long block_start(int block_id) const;
+    // Id of the live block covering address (padding included), or -1.
+    // O(log n) for every allocator.
+    int block_at(size_t address) const;
+    // Requested bytes of a live block, 0 if there is none
+    size_t block_size(int block_id) const;
+
+    // Slides every used block down to close all holes; returns bytes moved.
+    // Block ids stay valid, relocation_map() gives their new starts.
+    size_t compact(CompactionTrigger trigger = CompactionTrigger::MANUAL);
+    // Same, but stops after roughly move_budget bytes; the next call
+    // resumes where this one left off
+    size_t compact_step(size_t move_budget,
+                        CompactionTrigger trigger = CompactionTrigger::MANUAL);
+
+    // Compact and retry when an allocation fails
+    void set_compact_on_failure(bool enabled) { compact_on_failure = enabled; }
+    // Compact after a free leaves external fragmentation at or above
+    // threshold percent; budget 0 means a full compaction
+    void set_compaction_threshold(double threshold, size_t budget);
+
+    // block_id -> new start for blocks moved by the last compaction
+    const map<int, size_t>& relocation_map() const { return relocations; }
+    const CompactionStats& get_compaction_stats() const { return compaction_stats; }
+
+    // All O(1): maintained as blocks change rather than by walking the list
+    size_t get_total_memory() const { return total_memory; }
+    size_t get_used_memory() const;
+    size_t get_free_memory() const;
+    size_t get_largest_free() const;
+    size_t get_internal_fragmentation() const;
+    double external_fragmentation() const;
+    size_t get_total_requests() const { return total_requests; }
+    size_t get_failed_allocs() const { return failed_allocs; }
+    size_t get_block_count() const { return blocks.size(); }
+
+    // Per-CPU lists, lazy merging and migrate types of the buddy allocator
+    BuddyAllocator& get_buddy() { return buddy; }
+    const BuddyAllocator& get_buddy() const { return buddy; }
+
     void dump_memory() const;
     void print_stats() const;
+    void print_compaction_history() const;
+
+    // Snapshot of the heap and the buddy allocator. can_load() checks
+    // that the sections exist and describe a consistent heap; load()
+    // changes nothing unless it passes.
+    void save(CheckpointWriter& out) const;
+    bool can_load(const CheckpointReader& in) const;
+    bool load(const CheckpointReader& in);
 
 private:
     size_t total_memory;
@@ -41,7 +108,43 @@ private:
     size_t successful_allocs;
     size_t failed_allocs;
     BuddyAllocator buddy;
+    ReallocStats realloc_stats;
+
+    CompactionStats compaction_stats;
+    map<int, size_t> relocations;
+    bool compact_on_failure;
+    double compact_threshold;     // percent, 0 = off
+    size_t compact_budget;        // bytes per threshold-triggered step, 0 = full
+    size_t compact_from;          // no free block starts below this address
+
+    // block_id -> its list node, for O(1) lookup by id
+    unordered_map<int, list<Block>::iterator> used_index;
+    // start -> block_id of the used blocks, for lookups by address
+    map<size_t, int> used_starts;
+
+    // Running totals for the list allocators
+    multiset<size_t> free_sizes;  // largest free block is the last entry
+    size_t free_bytes;
+    size_t used_bytes;
+    size_t used_blocks;
+    size_t internal_frag;
 
+    list<Block>::iterator find_free_block(size_t size, size_t align, size_t& padding);
+    list<Block>::iterator find_used_block(int block_id);
+    void place_block(list<Block>::iterator selected, size_t size,
+                     size_t padding, size_t align, int block_id);
+    int allocate(size_t size, size_t align);
+    size_t slide_blocks(size_t move_budget, CompactionTrigger trigger);
+    list<Block>::iterator first_uncompacted(size_t& cursor);
+    void mark_hole(size_t start) { compact_from = std::min(compact_from, start); }
+    void track_free(size_t size);
+    void untrack_free(size_t size);
+    void track_used(size_t size, size_t requested);
+    void untrack_used(const Block& block);
+    void release_block(list<Block>::iterator it);
+    void shrink_block(list<Block>::iterator it, size_t new_size);
+    bool grow_in_place(list<Block>::iterator it, size_t new_size);
+    bool grow_into_previous(list<Block>::iterator it, size_t new_size);
 };
 
 
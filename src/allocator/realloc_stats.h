@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+
+// Resize and alignment costs, shared by the list and buddy allocators
+struct ReallocStats {
+    size_t realloc_requests = 0;
+    size_t in_place_grows = 0;
+    size_t in_place_shrinks = 0;
+    size_t relocations = 0;
+    size_t failed_reallocs = 0;
+    size_t bytes_copied = 0;        // payload moved by relocations
+    size_t bytes_copy_avoided = 0;  // payload kept in place
+    size_t aligned_requests = 0;
+    size_t alignment_padding = 0;   // bytes lost to alignment
+
+    bool used() const { return realloc_requests > 0 || aligned_requests > 0; }
+
+    void print(std::ostream& out) const {
+        if (realloc_requests > 0) {
+            out << "Realloc requests: " << realloc_requests << "\n";
+            out << "  in place (grow/shrink): " << in_place_grows
+                << "/" << in_place_shrinks << "\n";
+            out << "  relocated: " << relocations
+                << ", failed: " << failed_reallocs << "\n";
+            out << "  bytes copied: " << bytes_copied
+                << ", copy avoided: " << bytes_copy_avoided << "\n";
+
+            size_t served = realloc_requests - failed_reallocs;
+            if (served > 0) {
+                double rate = (double)(in_place_grows + in_place_shrinks) / served * 100.0;
+                out << "  copy avoidance rate: " << rate << "%\n";
+            }
+        }
+        if (aligned_requests > 0) {
+            out << "Aligned allocations: " << aligned_requests << "\n";
+            out << "Alignment padding: " << alignment_padding << " bytes\n";
+        }
+    }
+};
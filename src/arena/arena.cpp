@@ -0,0 +1,138 @@
+#include "arena.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) & ~(align - 1);
+}
+
+// Every allocation is a multiple of MIN_ALIGN, so every hole the list
+// allocators split off starts MIN_ALIGN-aligned as well
+static size_t payload_size(size_t size) {
+    return round_up(size ? size : 1, Arena::MIN_ALIGN);
+}
+
+Arena::Arena(size_t bytes, AllocatorType type)
+    : base(nullptr), length(0) {
+    if (type == AllocatorType::BUDDY) {
+        size_t p = 1;
+        while (p * 2 <= bytes && p * 2 <= ((size_t)1 << 30))
+            p *= 2;
+        bytes = p;
+    }
+    bytes = round_up(bytes, MIN_ALIGN);
+
+#ifdef _WIN32
+    void* region = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!region)
+        return;
+#else
+    // Pages are only backed once touched, so RSS follows the policy's layout
+    void* region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED)
+        return;
+#endif
+
+    base = static_cast<uint8_t*>(region);
+    length = bytes;
+    mem.set_allocator(type);
+    mem.init_memory(bytes);
+}
+
+Arena::~Arena() {
+    if (!base)
+        return;
+#ifdef _WIN32
+    VirtualFree(base, 0, MEM_RELEASE);
+#else
+    munmap(base, length);
+#endif
+}
+
+void* Arena::place(int block_id, size_t size, size_t requested) {
+    if (block_id == -1)
+        return nullptr;
+    size_t offset = (size_t)mem.block_start(block_id);
+    live[offset] = {block_id, size, requested};
+    rounding += size - requested;
+    return base + offset;
+}
+
+void* Arena::alloc(size_t size) {
+    if (!base)
+        return nullptr;
+    size_t rounded = payload_size(size);
+    return place(mem.malloc_block(rounded), rounded, size);
+}
+
+void* Arena::alloc_aligned(size_t size, size_t align) {
+    if (!base)
+        return nullptr;
+    if (align <= MIN_ALIGN)
+        return alloc(size);
+    size_t rounded = payload_size(size);
+    return place(mem.malloc_aligned(rounded, align), rounded, size);
+}
+
+void Arena::free(void* ptr) {
+    if (!owns(ptr))
+        return;
+    auto it = live.find(static_cast<uint8_t*>(ptr) - base);
+    if (it == live.end())
+        return;
+    mem.free_block(it->second.block_id);
+    rounding -= it->second.size - it->second.requested;
+    live.erase(it);
+}
+
+void* Arena::realloc(void* ptr, size_t size) {
+    if (!ptr)
+        return alloc(size);
+    if (size == 0) {
+        free(ptr);
+        return nullptr;
+    }
+    if (!owns(ptr))
+        return nullptr;
+
+    size_t old_offset = static_cast<uint8_t*>(ptr) - base;
+    auto it = live.find(old_offset);
+    if (it == live.end())
+        return nullptr;
+
+    Allocation old = it->second;
+    size_t rounded = payload_size(size);
+    int block_id = mem.realloc_block(old.block_id, rounded);
+    if (block_id == -1)
+        return nullptr;
+
+    // The old block is already free in the heap, but nothing else has
+    // been placed over it yet
+    size_t offset = (size_t)mem.block_start(block_id);
+    if (offset != old_offset) {
+        std::memmove(base + offset, base + old_offset, old.size < rounded ? old.size : rounded);
+        live.erase(it);
+    }
+    rounding -= old.size - old.requested;
+    live[offset] = {block_id, rounded, size};
+    rounding += rounded - size;
+    return base + offset;
+}
+
+bool Arena::owns(const void* ptr) const {
+    const uint8_t* p = static_cast<const uint8_t*>(ptr);
+    return base && p >= base && p < base + length;
+}
+
+size_t Arena::usable_size(const void* ptr) const {
+    if (!owns(ptr))
+        return 0;
+    auto it = live.find(static_cast<const uint8_t*>(ptr) - base);
+    return it == live.end() ? 0 : it->second.size;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include "../allocator/memory_manager.h"
+
+// MemoryManager placing real allocations in an mmap'd region: block
+// offsets become pointers into the region. Compaction stays off, since
+// it would move memory the caller points into.
+//
+// Not thread-safe; callers lock around it (the malloc shim does).
+class Arena {
+public:
+    // Payload alignment of alloc() and realloc(), as malloc guarantees
+    static const size_t MIN_ALIGN = 16;
+
+    // Buddy arenas are rounded down to a power of two of at most 1 GiB,
+    // since buddy block ids are their offsets
+    Arena(size_t bytes, AllocatorType type);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // False if the region could not be mapped
+    bool valid() const { return base != nullptr; }
+
+    void* alloc(size_t size);
+    void* alloc_aligned(size_t size, size_t align);
+    // Only pointers returned by this arena; anything else is ignored
+    void free(void* ptr);
+    // Copies the payload when the allocator moves the block. On failure
+    // returns nullptr and leaves ptr allocated, as realloc does.
+    void* realloc(void* ptr, size_t size);
+
+    bool owns(const void* ptr) const;
+    size_t usable_size(const void* ptr) const;
+
+    size_t size() const { return length; }
+    const MemoryManager& heap() const { return mem; }
+    // Bytes live allocations lost to rounding up to MIN_ALIGN, which the
+    // heap sees as part of the request
+    size_t rounding_waste() const { return rounding; }
+    // The heap's figure plus the rounding
+    size_t internal_fragmentation() const {
+        return mem.get_internal_fragmentation() + rounding;
+    }
+
+private:
+    uint8_t* base;
+    size_t length;
+    MemoryManager mem;
+
+    struct Allocation {
+        int block_id;
+        size_t size;        // usable bytes
+        size_t requested;   // bytes asked for, before rounding
+    };
+    // Payload offset -> block, to find the block behind a pointer
+    std::unordered_map<size_t, Allocation> live;
+    size_t rounding = 0;
+
+    void* place(int block_id, size_t size, size_t requested);
+};
@@ -0,0 +1,71 @@
+#include "memsim_arena.h"
+#include <new>
+#include "arena.h"
+#include "../io/output.h"
+
+struct memsim_arena {
+    Arena arena;
+    memsim_arena(size_t bytes, AllocatorType type) : arena(bytes, type) {}
+};
+
+static AllocatorType allocator_of(memsim_policy policy) {
+    switch (policy) {
+    case MEMSIM_BEST_FIT:   return AllocatorType::BEST_FIT;
+    case MEMSIM_WORST_FIT:  return AllocatorType::WORST_FIT;
+    case MEMSIM_BUDDY:      return AllocatorType::BUDDY;
+    default:                return AllocatorType::FIRST_FIT;
+    }
+}
+
+extern "C" {
+
+memsim_arena* memsim_arena_create(size_t bytes, memsim_policy policy) {
+    memsim_arena* a = new (std::nothrow) memsim_arena(bytes, allocator_of(policy));
+    if (a && !a->arena.valid()) {
+        delete a;
+        return nullptr;
+    }
+    return a;
+}
+
+void memsim_arena_destroy(memsim_arena* arena) {
+    delete arena;
+}
+
+void* memsim_arena_alloc(memsim_arena* arena, size_t size) {
+    return arena->arena.alloc(size);
+}
+
+void* memsim_arena_alloc_aligned(memsim_arena* arena, size_t size, size_t alignment) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        return nullptr;
+    return arena->arena.alloc_aligned(size, alignment);
+}
+
+void memsim_arena_free(memsim_arena* arena, void* ptr) {
+    arena->arena.free(ptr);
+}
+
+void* memsim_arena_realloc(memsim_arena* arena, void* ptr, size_t size) {
+    return arena->arena.realloc(ptr, size);
+}
+
+int memsim_arena_owns(const memsim_arena* arena, const void* ptr) {
+    return arena->arena.owns(ptr);
+}
+
+size_t memsim_arena_usable_size(const memsim_arena* arena, const void* ptr) {
+    return arena->arena.usable_size(ptr);
+}
+
+void memsim_arena_print_stats(const memsim_arena* arena) {
+    const Arena& a = arena->arena;
+    a.heap().print_stats();
+    // The heap only sees rounded requests
+    Output::stream() << "Size rounding: " << a.rounding_waste() << " bytes, "
+                     << "internal fragmentation with rounding: "
+                     << a.internal_fragmentation() << " bytes\n";
+    Output::flush();
+}
+
+}
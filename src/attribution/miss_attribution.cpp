@@ -0,0 +1,102 @@
+#include "miss_attribution.h"
+#include <algorithm>
+
+uint64_t BlockMisses::misses(MissKind kind) const {
+    switch (kind) {
+    case MissKind::L1:          return l1_misses;
+    case MissKind::L2:          return l2_misses;
+    case MissKind::TLB:         return tlb_misses;
+    case MissKind::PAGE_FAULT:  return page_faults;
+    case MissKind::ALL:         break;
+    }
+    return l1_misses + l2_misses + tlb_misses + page_faults;
+}
+
+void MissAttribution::record(int block_id, size_t bytes, bool l1_miss, bool l2_miss,
+                             bool tlb_miss, bool page_fault) {
+    BlockMisses* row = &unowned;
+    if (block_id != -1) {
+        row = &live[block_id];
+        row->block_id = block_id;
+        row->bytes = bytes;
+    }
+    row->accesses++;
+    row->l1_misses += l1_miss;
+    row->l2_misses += l2_miss;
+    row->tlb_misses += tlb_miss;
+    row->page_faults += page_fault;
+}
+
+void MissAttribution::retire(int block_id) {
+    auto found = live.find(block_id);
+    if (found == live.end())
+        return;
+    found->second.live = false;
+    retired.push_back(found->second);
+    live.erase(found);
+}
+
+void MissAttribution::rename(int old_id, int new_id) {
+    auto found = live.find(old_id);
+    if (found == live.end() || old_id == new_id)
+        return;
+    BlockMisses row = found->second;
+    live.erase(found);
+    row.block_id = new_id;
+    live[new_id] = row;
+}
+
+void MissAttribution::reset() {
+    live.clear();
+    retired.clear();
+    unowned = BlockMisses();
+}
+
+void MissAttribution::print_top(std::ostream& out, size_t n, MissKind kind) const {
+    std::vector<const BlockMisses*> rows;
+    for (const auto& [id, row] : live) {
+        if (row.misses(kind) > 0)
+            rows.push_back(&row);
+    }
+    for (const BlockMisses& row : retired) {
+        if (row.misses(kind) > 0)
+            rows.push_back(&row);
+    }
+
+    if (rows.empty()) {
+        out << "No misses attributed to blocks\n";
+    } else {
+        print_table(out, rows, n, kind, false);
+        print_table(out, rows, n, kind, true);
+    }
+    if (unowned.accesses > 0)
+        out << "Outside live blocks: " << unowned.accesses << " accesses, "
+            << unowned.misses(kind) << " misses\n";
+}
+
+void MissAttribution::print_table(std::ostream& out, std::vector<const BlockMisses*>& rows,
+                                  size_t n, MissKind kind, bool per_byte) const {
+    auto score = [&](const BlockMisses* row) {
+        double misses = (double)row->misses(kind);
+        return per_byte ? misses / std::max<size_t>(row->bytes, 1) : misses;
+    };
+    // Ties go to the lower id, so reports are stable across runs
+    size_t shown = std::min(n, rows.size());
+    std::partial_sort(rows.begin(), rows.begin() + shown, rows.end(),
+        [&](const BlockMisses* a, const BlockMisses* b) {
+            double sa = score(a), sb = score(b);
+            return sa != sb ? sa > sb : a->block_id < b->block_id;
+        });
+
+    out << "Top " << shown << " blocks by misses" << (per_byte ? " per byte" : "") << ":\n";
+    for (size_t i = 0; i < shown; i++) {
+        const BlockMisses& row = *rows[i];
+        out << "  " << i + 1 << ". block " << row.block_id << " (" << row.bytes << " bytes, "
+            << (row.live ? "live" : "freed") << "): " << row.accesses << " accesses, "
+            << row.l1_misses << " L1, " << row.l2_misses << " L2, "
+            << row.tlb_misses << " TLB, " << row.page_faults << " faults";
+        if (per_byte)
+            out << ", " << score(&row) << " per byte";
+        out << "\n";
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+enum class MissKind {
+    L1,
+    L2,
+    TLB,
+    PAGE_FAULT,
+    ALL
+};
+
+// What one allocation cost the memory hierarchy while it was live
+struct BlockMisses {
+    int block_id = -1;
+    size_t bytes = 0;           // requested size when last accessed
+    bool live = true;
+    uint64_t accesses = 0;
+    uint64_t l1_misses = 0;
+    uint64_t l2_misses = 0;
+    uint64_t tlb_misses = 0;
+    uint64_t page_faults = 0;
+
+    uint64_t misses(MissKind kind) const;
+};
+
+// Charges accesses and the misses they cause to the allocation that owns
+// the address. One row per allocation: freeing a block retires its row,
+// so a buddy address that is reused (ids are addresses) starts a new one.
+class MissAttribution {
+public:
+    void set_enabled(bool on) { enabled = on; }
+    bool is_enabled() const { return enabled; }
+
+    // block_id -1 is an access outside every live block
+    void record(int block_id, size_t bytes, bool l1_miss, bool l2_miss,
+                bool tlb_miss, bool page_fault);
+    void retire(int block_id);
+    // A buddy block that realloc moved gets a new id (its address); its
+    // row follows it
+    void rename(int old_id, int new_id);
+    void reset();
+
+    // Top n rows by misses of kind, and by the same misses per byte
+    void print_top(std::ostream& out, size_t n, MissKind kind) const;
+
+private:
+    bool enabled = false;
+    std::unordered_map<int, BlockMisses> live;
+    std::vector<BlockMisses> retired;
+    BlockMisses unowned;
+
+    void print_table(std::ostream& out, std::vector<const BlockMisses*>& rows,
+                     size_t n, MissKind kind, bool per_byte) const;
+};
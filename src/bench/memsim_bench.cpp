@@ -0,0 +1,528 @@
+// Microbenchmarks for every simulator component.
+//
+//   ./memsim_bench [--quick] [--csv] [--filter <substring>]
+//
+// Prints one JSON object per line (or CSV with --csv) so that runs from
+// before and after a change can be diffed or loaded side by side.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "allocator/memory_manager.h"
+#include "arena/arena.h"
+#include "cache/cache.h"
+#include "io/output.h"
+#include "simulator/simulator.h"
+#include "trace/trace_writer.h"
+#include "virtual_memory/TLB.h"
+#include "virtual_memory/VirtualMemory.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+
+struct BenchResult {
+    string name;
+    vector<pair<string, string>> params;
+    uint64_t ops = 0;
+    double seconds = 0;
+    vector<pair<string, double>> metrics;   // extra numbers, e.g. hit rate
+};
+
+struct Options {
+    bool quick = false;
+    bool csv = false;
+    string filter;
+    double min_seconds = 0.2;
+};
+
+Options options;
+bool csv_header_done = false;
+
+void report(const BenchResult& r) {
+    double ns_per_op = r.ops ? r.seconds * 1e9 / r.ops : 0;
+    double ops_per_sec = r.seconds > 0 ? r.ops / r.seconds : 0;
+
+    if (options.csv) {
+        // Parameters differ per benchmark, so they go in one key=value column
+        if (!csv_header_done) {
+            printf("bench,params,ops,seconds,ns_per_op,ops_per_sec,metrics\n");
+            csv_header_done = true;
+        }
+        printf("%s,", r.name.c_str());
+        for (size_t i = 0; i < r.params.size(); i++)
+            printf("%s%s=%s", i ? ";" : "", r.params[i].first.c_str(), r.params[i].second.c_str());
+        printf(",%llu,%.6f,%.2f,%.0f,", (unsigned long long)r.ops, r.seconds, ns_per_op, ops_per_sec);
+        for (size_t i = 0; i < r.metrics.size(); i++)
+            printf("%s%s=%.6f", i ? ";" : "", r.metrics[i].first.c_str(), r.metrics[i].second);
+        printf("\n");
+    } else {
+        printf("{\"bench\":\"%s\"", r.name.c_str());
+        for (const auto& [key, value] : r.params) {
+            bool numeric = value.find_first_not_of("0123456789") == string::npos;
+            printf(numeric ? ",\"%s\":%s" : ",\"%s\":\"%s\"", key.c_str(), value.c_str());
+        }
+        printf(",\"ops\":%llu,\"seconds\":%.6f,\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f",
+               (unsigned long long)r.ops, r.seconds, ns_per_op, ops_per_sec);
+        for (const auto& [key, value] : r.metrics)
+            printf(",\"%s\":%.6f", key.c_str(), value);
+        printf("}\n");
+    }
+    fflush(stdout);
+}
+
+bool selected(const string& name) {
+    return options.filter.empty() || name.find(options.filter) != string::npos;
+}
+
+// Runs body(n) with growing batch sizes until a batch takes at least
+// min_seconds, and reports the last batch
+template <typename Body>
+void measure(BenchResult& result, Body body) {
+    uint64_t batch = 1024;
+    while (true) {
+        auto start = Clock::now();
+        body(batch);
+        double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+        if (seconds >= options.min_seconds || batch >= (1ull << 32)) {
+            result.ops = batch;
+            result.seconds = seconds;
+            return;
+        }
+        // Aim a little past the target so the next batch is usually the last
+        double scale = seconds > 0 ? options.min_seconds * 1.2 / seconds : 16;
+        batch = (uint64_t)(batch * min(max(scale, 2.0), 16.0));
+    }
+}
+
+const char* allocator_name(AllocatorType type) {
+    switch (type) {
+    case AllocatorType::FIRST_FIT: return "first_fit";
+    case AllocatorType::BEST_FIT:  return "best_fit";
+    case AllocatorType::WORST_FIT: return "worst_fit";
+    case AllocatorType::BUDDY:     return "buddy";
+    }
+    return "?";
+}
+
+// Steady state with a fixed number of live blocks: each op frees a random
+// live block and allocates a new one of random size
+void bench_malloc_free() {
+    if (!selected("malloc_free"))
+        return;
+
+    const AllocatorType types[] = {
+        AllocatorType::FIRST_FIT, AllocatorType::BEST_FIT,
+        AllocatorType::WORST_FIT, AllocatorType::BUDDY
+    };
+    vector<size_t> heaps = {1 << 16, 1 << 20, 1 << 24};
+    vector<size_t> lives = {16, 256, 4096};
+    if (options.quick) {
+        heaps = {1 << 16, 1 << 20};
+        lives = {16, 256};
+    }
+
+    const size_t max_request = 256;
+    for (AllocatorType type : types) {
+        for (size_t heap : heaps) {
+            for (size_t live : lives) {
+                // Leave room for fragmentation so failures stay rare
+                if (live * max_request * 2 > heap)
+                    continue;
+
+                BenchResult result;
+                result.name = "malloc_free";
+                result.params = {{"allocator", allocator_name(type)},
+                                 {"heap", to_string(heap)},
+                                 {"live", to_string(live)}};
+
+                MemoryManager mem;
+                mem.set_allocator(type);
+                mem.init_memory(heap);
+
+                mt19937_64 rng(42);
+                vector<int> ids;
+                for (size_t i = 0; i < live; i++) {
+                    int id = mem.malloc_block(1 + rng() % max_request);
+                    if (id != -1)
+                        ids.push_back(id);
+                }
+
+                measure(result, [&](uint64_t n) {
+                    for (uint64_t i = 0; i < n; i++) {
+                        size_t k = rng() % ids.size();
+                        mem.free_block(ids[k]);
+                        // A failed slot (-1) is simply retried next time
+                        ids[k] = mem.malloc_block(1 + rng() % max_request);
+                    }
+                });
+
+                result.metrics = {{"failure_rate",
+                    (double)mem.get_failed_allocs() / max<size_t>(mem.get_total_requests(), 1)}};
+                report(result);
+            }
+        }
+    }
+}
+
+// Same-size alloc/free churn on the buddy allocator, eager against the
+// Linux-style front ends; splits and merges per op show the work saved
+void bench_buddy_frontends() {
+    if (!selected("buddy_churn"))
+        return;
+
+    struct Mode { const char* name; size_t cpus; bool lazy; };
+    const Mode modes[] = {
+        {"eager", 0, false}, {"pcp", 1, false}, {"lazy", 0, true}, {"pcp_lazy", 1, true}
+    };
+    vector<size_t> sizes = {16, 64, 256};
+    if (options.quick)
+        sizes = {64};
+
+    const size_t heap = 1 << 20;
+    const size_t live = 64;
+    for (const Mode& mode : modes) {
+        for (size_t size : sizes) {
+            BenchResult result;
+            result.name = "buddy_churn";
+            result.params = {{"mode", mode.name}, {"size", to_string(size)},
+                             {"live", to_string(live)},
+                             {"watermark", to_string(mode.lazy ? 16 * live : 0)}};
+
+            BuddyConfig config;
+            config.pcp_cpus = mode.cpus;
+            config.lazy_merge = mode.lazy;
+            config.merge_watermark = 16 * live;
+            BuddyAllocator buddy(heap);
+            buddy.configure(config);
+
+            mt19937_64 rng(7);
+            vector<int> addrs;
+            for (size_t i = 0; i < live; i++)
+                addrs.push_back(buddy.malloc_block(size));
+
+            // Rounds of freeing the whole live set in random order and
+            // allocating it again; one op is one free plus one malloc
+            uint64_t ops = 0;
+            measure(result, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i += live) {
+                    shuffle(addrs.begin(), addrs.end(), rng);
+                    for (int addr : addrs)
+                        buddy.free_block(addr);
+                    for (int& addr : addrs)
+                        addr = buddy.malloc_block(size);
+                }
+                ops += (n + live - 1) / live * live;
+            });
+
+            const BuddyStats& stats = buddy.get_stats();
+            result.metrics = {{"splits_per_op", (double)stats.splits / ops},
+                              {"merges_per_op", (double)stats.merges / ops}};
+            report(result);
+        }
+    }
+}
+
+// malloc_free on real memory: each new block is written and a random live
+// block is read back, so layout shows up as cache misses. "system" is the
+// libc malloc for reference; span is the address range the live set covers.
+void bench_arena() {
+    if (!selected("arena_alloc"))
+        return;
+
+    const char* policies[] = {"first_fit", "best_fit", "worst_fit", "buddy", "system"};
+    const AllocatorType types[] = {
+        AllocatorType::FIRST_FIT, AllocatorType::BEST_FIT,
+        AllocatorType::WORST_FIT, AllocatorType::BUDDY, AllocatorType::FIRST_FIT
+    };
+    vector<size_t> lives = {256, 4096};
+    if (options.quick)
+        lives = {256};
+
+    const size_t max_request = 256;
+    const size_t heap = 1 << 24;
+    for (size_t p = 0; p < 5; p++) {
+        bool system = p == 4;
+        for (size_t live : lives) {
+            BenchResult result;
+            result.name = "arena_alloc";
+            result.params = {{"allocator", policies[p]},
+                             {"heap", to_string(heap)},
+                             {"live", to_string(live)}};
+
+            Arena arena(heap, types[p]);
+            auto alloc = [&](size_t size) {
+                char* ptr = (char*)(system ? malloc(size) : arena.alloc(size));
+                if (ptr)
+                    memset(ptr, (int)size, size);
+                return ptr;
+            };
+            auto release = [&](char* ptr) {
+                if (system)
+                    free(ptr);
+                else
+                    arena.free(ptr);
+            };
+
+            mt19937_64 rng(42);
+            vector<char*> ptrs;
+            for (size_t i = 0; i < live; i++)
+                ptrs.push_back(alloc(1 + rng() % max_request));
+
+            volatile char sink;
+            measure(result, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    size_t k = rng() % ptrs.size();
+                    release(ptrs[k]);
+                    ptrs[k] = alloc(1 + rng() % max_request);
+                    if (char* q = ptrs[rng() % ptrs.size()])
+                        sink = q[0];
+                }
+            });
+
+            uintptr_t lo = UINTPTR_MAX, hi = 0;
+            for (char* ptr : ptrs) {
+                if (!ptr)
+                    continue;
+                lo = min(lo, (uintptr_t)ptr);
+                hi = max(hi, (uintptr_t)ptr);
+            }
+            result.metrics = {{"span_kib", hi > lo ? (hi - lo) / 1024.0 : 0}};
+            for (char* ptr : ptrs)
+                if (ptr)
+                    release(ptr);
+            report(result);
+        }
+    }
+}
+
+// Hit rate is steered by the working set: half the cache fits entirely,
+// a working set twice the cache thrashes FIFO, and a random set in
+// between gives a partial hit rate
+void bench_cache() {
+    if (!selected("cache_access"))
+        return;
+
+    struct Geometry { size_t size, block; };
+    vector<Geometry> geometries = {{128, 16}, {512, 16}, {4096, 64}, {32768, 64}};
+    if (options.quick)
+        geometries = {{128, 16}, {4096, 64}};
+
+    struct Pattern { const char* name; double working_set; bool random; };
+    const Pattern patterns[] = {
+        {"fits", 0.5, false},
+        {"random", 1.5, true},
+        {"thrash", 2.0, false}
+    };
+
+    for (const Geometry& g : geometries) {
+        for (const Pattern& p : patterns) {
+            for (bool specialized : {true, false}) {
+                BenchResult result;
+                result.name = "cache_access";
+                result.params = {{"size", to_string(g.size)},
+                                 {"block", to_string(g.block)},
+                                 {"pattern", p.name},
+                                 {"engine", specialized ? "specialized" : "dynamic"}};
+
+                Cache cache(g.size, g.block, 1);
+                cache.set_specialized(specialized);
+                size_t span = (size_t)(g.size * p.working_set);
+
+                // Precomputed addresses keep the RNG out of the timed loop
+                mt19937_64 rng(7);
+                vector<size_t> addrs(1 << 16);
+                for (size_t i = 0; i < addrs.size(); i++)
+                    addrs[i] = p.random ? rng() % span : (i * g.block) % span;
+
+                size_t before_hits = 0, before_misses = 0;
+                measure(result, [&](uint64_t n) {
+                    before_hits = cache.get_hits();
+                    before_misses = cache.get_misses();
+                    for (uint64_t i = 0; i < n; i++)
+                        cache.access(addrs[i & (addrs.size() - 1)]);
+                });
+
+                size_t hits = cache.get_hits() - before_hits;
+                size_t misses = cache.get_misses() - before_misses;
+                result.metrics = {{"hit_rate", (double)hits / max<size_t>(hits + misses, 1)}};
+                report(result);
+            }
+        }
+    }
+}
+
+void bench_tlb() {
+    if (!selected("tlb_lookup"))
+        return;
+
+    vector<int> sizes = {4, 16, 64, 256};
+    if (options.quick)
+        sizes = {4, 64};
+
+    for (int size : sizes) {
+        for (int spread : {1, 2, 8}) {
+            for (bool specialized : {true, false}) {
+                BenchResult result;
+                result.name = "tlb_lookup";
+                result.params = {{"entries", to_string(size)},
+                                 {"pages", to_string(size * spread)},
+                                 {"engine", specialized ? "specialized" : "dynamic"}};
+
+                TLB tlb(size);
+                tlb.set_specialized(specialized);
+                mt19937_64 rng(11);
+                vector<int> pages(1 << 16);
+                for (int& page : pages)
+                    page = rng() % (size * spread);
+
+                int before_hits = 0, before_misses = 0;
+                measure(result, [&](uint64_t n) {
+                    before_hits = tlb.get_hits();
+                    before_misses = tlb.get_misses();
+                    int frame;
+                    for (uint64_t i = 0; i < n; i++) {
+                        int page = pages[i & (pages.size() - 1)];
+                        if (!tlb.lookup(page, frame))
+                            tlb.insert(page, page);
+                    }
+                });
+
+                // int counters wrap on the longest runs; report the last batch only
+                double hits = (unsigned)(tlb.get_hits() - before_hits);
+                double misses = (unsigned)(tlb.get_misses() - before_misses);
+                result.metrics = {{"hit_rate", hits / max(hits + misses, 1.0)}};
+                report(result);
+            }
+        }
+    }
+}
+
+void bench_vm() {
+    if (!selected("vm_access"))
+        return;
+
+    vector<int> frame_counts = {4, 64, 1024};
+    if (options.quick)
+        frame_counts = {4, 64};
+
+    const int page_size = 16;
+    for (int frames : frame_counts) {
+        for (int spread : {1, 4}) {
+            BenchResult result;
+            result.name = "vm_access";
+            result.params = {{"frames", to_string(frames)},
+                             {"pages", to_string(frames * spread)}};
+
+            VirtualMemory vm(frames);
+            mt19937_64 rng(13);
+            vector<int> addrs(1 << 16);
+            for (int& a : addrs)
+                a = rng() % (frames * spread * page_size);
+
+            int before_hits = 0, before_faults = 0;
+            measure(result, [&](uint64_t n) {
+                before_hits = vm.get_page_hits();
+                before_faults = vm.get_page_faults();
+                for (uint64_t i = 0; i < n; i++)
+                    vm.access(addrs[i & (addrs.size() - 1)], i & 1);
+            });
+
+            double hits = (unsigned)(vm.get_page_hits() - before_hits);
+            double faults = (unsigned)(vm.get_page_faults() - before_faults);
+            result.metrics = {{"fault_rate", faults / max(hits + faults, 1.0)}};
+            report(result);
+        }
+    }
+}
+
+// Writes a synthetic alloc/free/access trace and replays it through a
+// full Simulator (VM -> L1 -> L2 -> memory) once per batch
+void bench_replay() {
+    BenchResult result;
+    result.name = "trace_replay";
+    if (!selected(result.name))
+        return;
+
+    const size_t records = options.quick ? 100000 : 1000000;
+    string path = "/tmp/memsim_bench_" + to_string(records) + ".mstr";
+
+    TraceWriter writer;
+    if (!writer.open(path)) {
+        fprintf(stderr, "cannot write %s\n", path.c_str());
+        return;
+    }
+
+    mt19937_64 rng(17);
+    vector<uint64_t> live;
+    for (size_t i = 0; i < records; i++) {
+        uint64_t r = rng() % 10;
+        if (r < 2 || live.empty()) {
+            live.push_back(writer.allocations());
+            writer.append(TraceOp::ALLOC, 1 + rng() % 128);
+        } else if (r < 4) {
+            size_t k = rng() % live.size();
+            writer.append(TraceOp::FREE, live[k]);
+            live[k] = live.back();
+            live.pop_back();
+        } else {
+            writer.append(r < 9 ? TraceOp::ACCESS : TraceOp::WRITE, rng() % 4096);
+        }
+    }
+    writer.close();
+    result.params = {{"records", to_string(records)},
+                     {"trace_bytes", to_string(writer.bytes_written())}};
+
+    uint64_t replays = 0;
+    auto start = Clock::now();
+    do {
+        Simulator sim;
+        sim.memory().init_memory(1 << 20);
+        sim.replay_trace(path);
+        replays++;
+    } while (chrono::duration<double>(Clock::now() - start).count() < options.min_seconds);
+
+    result.seconds = chrono::duration<double>(Clock::now() - start).count();
+    result.ops = replays * records;
+    report(result);
+    remove(path.c_str());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--quick"))
+            options.quick = true;
+        else if (!strcmp(argv[i], "--csv"))
+            options.csv = true;
+        else if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+            options.filter = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--quick] [--csv] [--filter <substring>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (options.quick)
+        options.min_seconds = 0.05;
+
+    // Components log through Output; keep the benchmark output clean
+    Output::set_verbosity(Verbosity::QUIET);
+
+    bench_malloc_free();
+    bench_arena();
+    bench_buddy_frontends();
+    bench_cache();
+    bench_tlb();
+    bench_vm();
+    bench_replay();
+    return 0;
+}
@@ -1,5 +1,8 @@
 #include "buddy_allocator.h"
 #include <iostream>
+#include "../io/output.h"
+#include "../profile/profiler.h"
+#include "../checkpoint/checkpoint.h"
 #include <algorithm>
 using namespace std;
 
@@ -24,10 +27,41 @@ void BuddyAllocator::init(size_t size) {
     internal_fragmentation = 0;
     used_memory = 0;
     total_requests = 0;
+    realloc_stats = ReallocStats();
+    stats = BuddyStats();
+    pending_merges = 0;
+    setup_front_ends();
 
     BuddyBlock block {0, size, true};
     free_lists[size].push_back(block);
 }
+
+// Empty per-CPU lists and unclaimed pageblocks for the current config
+void BuddyAllocator::setup_front_ends() {
+    pcp_lists.assign(config.pcp_cpus * (size_t)MigrateType::COUNT * (config.pcp_max_order + 1), {});
+    pcp_blocks = 0;
+
+    size_t pageblocks = 0;
+    if (config.pageblock_size)
+        pageblocks = (total_memory + config.pageblock_size - 1) / config.pageblock_size;
+    pageblock_types.assign(pageblocks, MigrateType::COUNT);
+}
+
+void BuddyAllocator::configure(const BuddyConfig& next) {
+    drain();
+
+    config = next;
+    config.pcp_cpus = min(config.pcp_cpus, MAX_PCP_CPUS);
+    config.pcp_batch = max<size_t>(config.pcp_batch, 1);
+    if (config.pageblock_size)
+        config.pageblock_size = max(next_power_of_two(config.pageblock_size), min_block_size);
+    setup_front_ends();
+
+    // Pageblocks already in use are taken to hold movable memory, the
+    // Linux default
+    for (const auto &[address, sizes] : allocated_blocks)
+        mark_pageblocks(address, sizes.first, MigrateType::MOVABLE);
+}
 size_t BuddyAllocator::next_power_of_two(size_t n) const {
     size_t p = 1;
     while (p < n) p <<= 1;
@@ -45,11 +79,16 @@ void BuddyAllocator::split_block(size_t size) {
     BuddyBlock block = free_lists[larger].back();
     free_lists[larger].pop_back();
 
-    BuddyBlock left  {block.start, size, true};
-    BuddyBlock right {block.start + size, size, true};
-
-    free_lists[size].push_back(left);
-    free_lists[size].push_back(right);
+    free_lists[size].push_back({block.start, size, true});
+    free_upper_half(block.start, size);
+}
+// Splits the block at start in two halves of size and frees the upper one
+void BuddyAllocator::free_upper_half(size_t start, size_t size) {
+    MEMSIM_COUNT(BUDDY_SPLITS, 1);
+    stats.splits++;
+    free_lists[size].push_back({start + size, size, true});
+    if (config.pageblock_size && size >= config.pageblock_size)
+        mark_pageblocks(start + size, size, MigrateType::COUNT);
 }
 int BuddyAllocator::malloc_block(size_t request_size) {
 
@@ -57,21 +96,84 @@ int BuddyAllocator::malloc_block(size_t request_size) {
 
     size_t block_size = max(next_power_of_two(request_size), min_block_size);
 
-
-    if (block_size > total_memory) {
+    int addr = allocate(block_size, request_size);
+    if (addr == -1) {
         failed_allocs++;
         return -1;
     }
 
+    successful_allocs++;
+    return addr;
+}
+
+// Takes a block of exactly block_size, from this CPU's list for low
+// orders, and records it as allocated
+int BuddyAllocator::allocate(size_t block_size, size_t request_size) {
+
+    if (block_size > total_memory)
+        return -1;
+
+    long long address = -1;
+    size_t order;
+    if (pcp_order(block_size, order)) {
+        auto &list = pcp_lists[pcp_index(order, current_type)];
+        if (!list.empty()) {
+            stats.pcp_hits++;
+        } else {
+            // Refill with a batch, so the next allocations skip the buddy lists
+            for (size_t i = 0; i < config.pcp_batch; i++) {
+                long long refill = take_block(block_size);
+                if (refill == -1)
+                    break;
+                list.push_back(refill);
+                pcp_blocks++;
+            }
+            // Hand the batch out in the order it was taken
+            reverse(list.begin(), list.end());
+            if (!list.empty())
+                stats.pcp_refills++;
+        }
+        if (!list.empty()) {
+            address = list.back();
+            list.pop_back();
+            pcp_blocks--;
+        }
+    } else {
+        address = take_block(block_size);
+    }
+
+    // Out of blocks: hand back what the per-CPU lists hold, do the
+    // pending merges and try once more
+    if (address == -1 && (pcp_blocks > 0 || pending_merges > 0)) {
+        drain();
+        address = take_block(block_size);
+    }
+    if (address == -1)
+        return -1;
+
+    allocated_blocks[address] = {block_size, request_size};
+
+    used_memory += block_size;
+    internal_fragmentation += (block_size - request_size);
+
+    return address;
+}
+
+// Removes a free block of exactly block_size from the buddy lists,
+// splitting a larger one if needed
+long long BuddyAllocator::take_block(size_t block_size) {
+
+    if (config.pageblock_size)
+        return take_grouped(block_size);
+
     if (free_lists[block_size].empty()) {
+        MEMSIM_PROBE(BUDDY_SPLIT);
         size_t bigger = block_size << 1;
         while (bigger <= total_memory && free_lists[bigger].empty())
             bigger <<= 1;
 
-        if (bigger > total_memory) {
-            failed_allocs++;
+        if (bigger > total_memory)
             return -1;
-        }
 
         while (bigger > block_size) {
             split_block(bigger >> 1);
@@ -81,15 +183,204 @@ int BuddyAllocator::malloc_block(size_t request_size) {
 
     BuddyBlock block = free_lists[block_size].back();
     free_lists[block_size].pop_back();
+    return block.start;
+}
+
+// Same, keeping migrate types apart: the smallest fitting block in a
+// pageblock of the current type, else in a wholly free pageblock, else
+// the largest block anywhere (stealing big, as Linux does, so the next
+// allocations fall back less often)
+long long BuddyAllocator::take_grouped(size_t block_size) {
+    MEMSIM_PROBE(BUDDY_SPLIT);
+    size_t pageblock = config.pageblock_size;
+    auto owner = [&](const BuddyBlock &b) {
+        return b.size >= pageblock ? MigrateType::COUNT : pageblock_types[b.start / pageblock];
+    };
+
+    size_t size = 0;
+    bool stolen = false;
+    vector<BuddyBlock>::iterator found;
+    for (MigrateType wanted : {current_type, MigrateType::COUNT}) {
+        for (size_t s = block_size; !size && s <= total_memory; s <<= 1) {
+            auto list = free_lists.find(s);
+            if (list == free_lists.end())
+                continue;
+            found = find_if(list->second.begin(), list->second.end(),
+                [&](const BuddyBlock &b) { return owner(b) == wanted; });
+            if (found != list->second.end())
+                size = s;
+        }
+    }
+    if (!size) {
+        for (auto it = free_lists.rbegin(); it != free_lists.rend(); ++it) {
+            if (it->first >= block_size && !it->second.empty()) {
+                size = it->first;
+                found = it->second.end() - 1;
+                stolen = true;
+                stats.migrate_fallbacks++;
+                break;
+            }
+        }
+        if (!size)
+            return -1;
+    }
+
+    size_t start = found->start;
+    free_lists[size].erase(found);
 
-    allocated_blocks[block.start] = {block_size, request_size};
+    // Stealing half a pageblock or more takes the whole pageblock over
+    if (stolen && size * 2 >= pageblock)
+        pageblock_types[start / pageblock] = current_type;
 
+    // Keep the upper half each time, as split_block() does
+    while (size > block_size) {
+        size >>= 1;
+        free_lists[size].push_back({start, size, true});
+        start += size;
+        MEMSIM_COUNT(BUDDY_SPLITS, 1);
+        stats.splits++;
+    }
+    mark_pageblocks(start, block_size, current_type);
+    return start;
+}
+
+// Claims the wholly free pageblocks under a block for type; COUNT marks
+// them all wholly free again
+void BuddyAllocator::mark_pageblocks(size_t address, size_t size, MigrateType type) {
+    size_t pageblock = config.pageblock_size;
+    if (!pageblock)
+        return;
+    size_t last = min((address + size - 1) / pageblock, pageblock_types.size() - 1);
+    for (size_t i = address / pageblock; i <= last; i++) {
+        if (type == MigrateType::COUNT || pageblock_types[i] == MigrateType::COUNT)
+            pageblock_types[i] = type;
+    }
+}
+
+MigrateType BuddyAllocator::type_at(size_t address) const {
+    if (!config.pageblock_size)
+        return MigrateType::MOVABLE;
+    return pageblock_types[address / config.pageblock_size];
+}
+
+// Orders count from the minimum block size; only the low ones are
+// cached per CPU
+bool BuddyAllocator::pcp_order(size_t block_size, size_t& order) const {
+    if (!config.pcp_cpus)
+        return false;
+    order = 0;
+    while ((min_block_size << order) < block_size)
+        order++;
+    return order <= config.pcp_max_order;
+}
+
+// Without pageblock grouping every block is MOVABLE, whatever type the
+// caller asked for, so allocation and free use the same list
+size_t BuddyAllocator::pcp_index(size_t order, MigrateType type) const {
+    if (type == MigrateType::COUNT || !config.pageblock_size)
+        type = MigrateType::MOVABLE;
+    size_t cpu = current_cpu % config.pcp_cpus;
+    return (cpu * (size_t)MigrateType::COUNT + (size_t)type) * (config.pcp_max_order + 1) + order;
+}
+
+int BuddyAllocator::malloc_aligned(size_t request_size, size_t align) {
+
+    total_requests++;
+    realloc_stats.aligned_requests++;
+
+    size_t natural = max(next_power_of_two(request_size), min_block_size);
+    size_t block_size = max(natural, next_power_of_two(align));
+
+    int addr = allocate(block_size, request_size);
+    if (addr == -1) {
+        failed_allocs++;
+        return -1;
+    }
 
     successful_allocs++;
-    used_memory += block_size;
-    internal_fragmentation += (block_size - request_size);
+    realloc_stats.alignment_padding += block_size - natural;
+    return addr;
+}
 
-    return block.start;
+// Removes the free block at address from its free list, if it is there
+bool BuddyAllocator::take_free_block(size_t address, size_t size) {
+    auto &list = free_lists[size];
+    auto it = find_if(list.begin(), list.end(),
+        [&](const BuddyBlock &b) { return b.start == address && b.free; });
+
+    if (it == list.end())
+        return false;
+
+    list.erase(it);
+    return true;
+}
+
+int BuddyAllocator::realloc_block(size_t address, size_t new_size) {
+
+    auto found = allocated_blocks.find(address);
+    if (found == allocated_blocks.end())
+        return -1;
+
+    realloc_stats.realloc_requests++;
+
+    auto [size, request_size] = found->second;
+    size_t new_block = max(next_power_of_two(new_size), min_block_size);
+
+    // Shrink: hand the upper halves back to the free lists
+    if (new_block <= size) {
+        size_t old_block = size;
+        while (size > new_block) {
+            size >>= 1;
+            free_upper_half(address, size);
+        }
+
+        used_memory -= old_block - size;
+        internal_fragmentation -= old_block - request_size;
+        internal_fragmentation += size - new_size;
+        found->second = {size, new_size};
+
+        realloc_stats.in_place_shrinks++;
+        realloc_stats.bytes_copy_avoided += new_size;
+        return address;
+    }
+
+    // Grow in place: every buddy above this block, up to the new size,
+    // must be free and this block must be the lower half each time
+    bool in_place = new_block <= total_memory && address % new_block == 0;
+    for (size_t s = size; in_place && s < new_block; s <<= 1) {
+        auto &list = free_lists[s];
+        in_place = find_if(list.begin(), list.end(),
+            [&](const BuddyBlock &b) { return b.start == address + s && b.free; })
+            != list.end();
+    }
+
+    if (in_place) {
+        for (size_t s = size; s < new_block; s <<= 1)
+            take_free_block(address + s, s);
+        // The absorbed buddies may cover wholly free pageblocks
+        mark_pageblocks(address, new_block, type_at(address));
+
+        used_memory += new_block - size;
+        internal_fragmentation -= size - request_size;
+        internal_fragmentation += new_block - new_size;
+        found->second = {new_block, new_size};
+
+        realloc_stats.in_place_grows++;
+        realloc_stats.bytes_copy_avoided += request_size;
+        return address;
+    }
+
+    // Relocate and copy the old payload
+    int new_address = allocate(new_block, new_size);
+    if (new_address == -1) {
+        realloc_stats.failed_reallocs++;
+        return -1;
+    }
+    free_block(address);
+
+    realloc_stats.relocations++;
+    realloc_stats.bytes_copied += request_size;
+    return new_address;
 }
 
 bool BuddyAllocator::free_block(size_t address) {
@@ -103,7 +394,41 @@ bool BuddyAllocator::free_block(size_t address) {
     used_memory -= size;
     internal_fragmentation -= (size - request_size);
 
+    size_t order;
+    if (pcp_order(size, order)) {
+        auto &list = pcp_lists[pcp_index(order, type_at(address))];
+        list.push_back(address);
+        pcp_blocks++;
+
+        // Over the high mark: the oldest batch goes back to the buddy lists
+        if (list.size() > config.pcp_high) {
+            size_t n = min(config.pcp_batch, list.size());
+            for (size_t i = 0; i < n; i++)
+                release(list[i], size);
+            list.erase(list.begin(), list.begin() + n);
+            pcp_blocks -= n;
+            stats.pcp_drains++;
+        }
+        return true;
+    }
 
+    release(address, size);
+    return true;
+}
+
+// Returns a block to the buddy lists, merging with free buddies now or,
+// with lazy merging, at the next coalesce()
+void BuddyAllocator::release(size_t address, size_t size) {
+
+    if (config.lazy_merge) {
+        free_lists[size].push_back({address, size, true});
+        stats.deferred_frees++;
+        if (++pending_merges >= config.merge_watermark)
+            coalesce();
+        return;
+    }
+
+    MEMSIM_PROBE(BUDDY_COALESCE);
     while (size < total_memory) {
         size_t buddy_addr = get_buddy_address(address, size);
 
@@ -117,47 +442,371 @@ bool BuddyAllocator::free_block(size_t address) {
             break;
 
         list.erase(it);
+        MEMSIM_COUNT(BUDDY_MERGES, 1);
+        stats.merges++;
         address = min(address, buddy_addr);
         size <<= 1;
     }
 
     BuddyBlock merged {address, size, true};
     free_lists[size].push_back(merged);
-    return true;
+    if (config.pageblock_size && size >= config.pageblock_size)
+        mark_pageblocks(address, size, MigrateType::COUNT);
+}
+
+// One bottom-up pass over the free lists: pairs of free buddies merge
+// into the next size, where they may pair up again
+void BuddyAllocator::coalesce() {
+    MEMSIM_PROBE(BUDDY_COALESCE);
+    stats.coalesce_passes++;
+    pending_merges = 0;
+
+    for (size_t size = min_block_size; size < total_memory; size <<= 1) {
+        auto found = free_lists.find(size);
+        if (found == free_lists.end() || found->second.size() < 2)
+            continue;
+
+        auto &list = found->second;
+        sort(list.begin(), list.end(),
+            [](const BuddyBlock &a, const BuddyBlock &b) { return a.start < b.start; });
+
+        vector<BuddyBlock> kept;
+        for (size_t i = 0; i < list.size(); i++) {
+            size_t start = list[i].start;
+            if (i + 1 < list.size() && start % (size << 1) == 0
+                && list[i + 1].start == start + size) {
+                free_lists[size << 1].push_back({start, size << 1, true});
+                MEMSIM_COUNT(BUDDY_MERGES, 1);
+                stats.merges++;
+                if (config.pageblock_size && (size << 1) >= config.pageblock_size)
+                    mark_pageblocks(start, size << 1, MigrateType::COUNT);
+                i++;
+            } else {
+                kept.push_back(list[i]);
+            }
+        }
+        list.swap(kept);
+    }
+}
+
+void BuddyAllocator::drain() {
+    size_t orders = config.pcp_max_order + 1;
+    for (size_t i = 0; i < pcp_lists.size(); i++) {
+        if (pcp_lists[i].empty())
+            continue;
+        size_t size = min_block_size << (i % orders);
+        for (size_t address : pcp_lists[i])
+            release(address, size);
+        pcp_lists[i].clear();
+        stats.pcp_drains++;
+    }
+    pcp_blocks = 0;
+
+    if (pending_merges > 0)
+        coalesce();
 }
 
 void BuddyAllocator::dump() const {
-    cout << "Buddy Free Lists:\n";
+    std::ostream& out = Output::stream();
+
+    out << "Buddy Free Lists:\n";
     for (const auto &[size, list] : free_lists) {
-        cout << "Size " << size << " : ";
+        out << "Size " << size << " : ";
         auto sorted = list;
         sort(sorted.begin(), sorted.end(),
             [](auto &a, auto &b) { return a.start < b.start; });
 
         for (auto &b : sorted)
-            cout << "[" << b.start << "] ";
+            out << "[" << b.start << "] ";
+
+        out << "\n";
+    }
+
+    for (size_t i = 0; i < pcp_lists.size(); i++) {
+        if (pcp_lists[i].empty())
+            continue;
+        size_t orders = config.pcp_max_order + 1;
+        size_t types = (size_t)MigrateType::COUNT;
+        out << "CPU " << i / orders / types << " size " << (min_block_size << (i % orders));
+        if (config.pageblock_size)
+            out << " type " << i / orders % types;
+        out << " : ";
+        for (size_t address : pcp_lists[i])
+            out << "[" << address << "] ";
+        out << "\n";
+    }
+}
+
+// Blocks are aligned to their size, so the only block of size s that
+// can cover address starts at address rounded down to s
+long long BuddyAllocator::block_at(size_t address) const {
+    if (address >= total_memory)
+        return -1;
+    for (size_t size = min_block_size; size <= total_memory; size <<= 1) {
+        size_t start = address & ~(size - 1);
+        auto found = allocated_blocks.find(start);
+        if (found != allocated_blocks.end() && found->second.first == size)
+            return start;
+    }
+    return -1;
+}
 
-        cout << "\n";
+// Free lists are keyed by block size, so the first non-empty list from
+// the top holds the largest free block
+size_t BuddyAllocator::get_largest_free() const {
+    for (auto it = free_lists.rbegin(); it != free_lists.rend(); ++it) {
+        if (!it->second.empty())
+            return it->first;
     }
+    return 0;
 }
 
 void BuddyAllocator::print_stats() const {
-    cout << "Allocation requests: " << total_requests << "\n";
-    cout << "Successful allocations: " << successful_allocs << "\n";
-    cout << "Failed allocations: " << failed_allocs << "\n";
+    std::ostream& out = Output::stream();
+
+    out << "Allocation requests: " << total_requests << "\n";
+    out << "Successful allocations: " << successful_allocs << "\n";
+    out << "Failed allocations: " << failed_allocs << "\n";
 
     if (total_requests > 0) {
         double failure_rate =
             (double)failed_allocs / total_requests * 100.0;
-        cout << "Failure rate: " << failure_rate << "%\n";
+        out << "Failure rate: " << failure_rate << "%\n";
     }
 
     double utilization =
         (double)used_memory / total_memory * 100.0;
 
-    cout << "Used memory: " << used_memory << " bytes\n";
-    cout << "Internal fragmentation: "
-         << internal_fragmentation << " bytes\n";
-    cout << "External fragmentation: 0%\n";
-    cout << "Utilization: " << utilization << "%\n";
+    out << "Used memory: " << used_memory << " bytes\n";
+    out << "Internal fragmentation: "
+        << internal_fragmentation << " bytes\n";
+    out << "External fragmentation: 0%\n";
+    out << "Utilization: " << utilization << "%\n";
+
+    if (realloc_stats.used())
+        realloc_stats.print(out);
+}
+
+void BuddyAllocator::print_buddy_stats() const {
+    std::ostream& out = Output::stream();
+
+    out << "Per-CPU lists: ";
+    if (config.pcp_cpus)
+        out << config.pcp_cpus << " CPUs, orders 0-" << config.pcp_max_order
+            << ", batch " << config.pcp_batch << ", high " << config.pcp_high
+            << ", " << pcp_blocks << " blocks held\n";
+    else
+        out << "off\n";
+
+    out << "Coalescing: ";
+    if (config.lazy_merge)
+        out << "lazy, watermark " << config.merge_watermark << ", "
+            << pending_merges << " pending\n";
+    else
+        out << "eager\n";
+
+    out << "Migrate-type grouping: ";
+    if (config.pageblock_size) {
+        size_t owned[(size_t)MigrateType::COUNT + 1] = {};
+        for (MigrateType type : pageblock_types)
+            owned[(size_t)type]++;
+        out << "pageblock " << config.pageblock_size << ", unmovable "
+            << owned[0] << ", movable " << owned[1] << ", reclaimable "
+            << owned[2] << ", free " << owned[3] << "\n";
+    } else {
+        out << "off\n";
+    }
+
+    stats.print(out);
+}
+
+struct BuddyCheckpoint {
+    size_t total_memory;
+    size_t min_block_size;
+    size_t successful_allocs;
+    size_t failed_allocs;
+    size_t internal_fragmentation;
+    size_t used_memory;
+    size_t total_requests;
+    ReallocStats realloc_stats;
+    BuddyConfig config;
+    BuddyStats stats;
+    size_t current_cpu;
+    MigrateType current_type;
+    size_t pending_merges;
+};
+
+// A block held on a per-CPU list
+struct BuddyPcpBlock {
+    size_t list;
+    size_t address;
+};
+
+// One free list: its block size and how many blocks follow in the
+// flattened block section. Empty lists are kept so dumps match.
+struct BuddyFreeList {
+    size_t size;
+    size_t count;
+};
+
+struct BuddyAllocation {
+    size_t address;
+    size_t block_size;
+    size_t requested;
+};
+
+void BuddyAllocator::save(CheckpointWriter& out) const {
+    BuddyCheckpoint state {total_memory, min_block_size, successful_allocs,
+                           failed_allocs, internal_fragmentation, used_memory,
+                           total_requests, realloc_stats, config, stats,
+                           current_cpu, current_type, pending_merges};
+    out.add_value(SectionId::BUDDY_STATE, state);
+
+    vector<BuddyFreeList> lists;
+    vector<BuddyBlock> free_blocks;
+    for (const auto &[size, list] : free_lists) {
+        lists.push_back({size, list.size()});
+        free_blocks.insert(free_blocks.end(), list.begin(), list.end());
+    }
+    out.add(SectionId::BUDDY_FREE_LISTS, lists);
+    out.add(SectionId::BUDDY_FREE_BLOCKS, free_blocks);
+
+    vector<BuddyAllocation> allocated;
+    for (const auto &[address, sizes] : allocated_blocks)
+        allocated.push_back({address, sizes.first, sizes.second});
+    out.add(SectionId::BUDDY_ALLOCATED, allocated);
+
+    vector<BuddyPcpBlock> held;
+    for (size_t i = 0; i < pcp_lists.size(); i++) {
+        for (size_t address : pcp_lists[i])
+            held.push_back({i, address});
+    }
+    out.add(SectionId::BUDDY_PCP, held);
+    out.add(SectionId::BUDDY_PAGEBLOCKS, pageblock_types);
+}
+
+// The sections of a buddy checkpoint, found but not applied yet
+struct BuddySections {
+    BuddyCheckpoint state;
+    const BuddyFreeList* lists = nullptr;
+    const BuddyBlock* blocks = nullptr;
+    const BuddyAllocation* allocated = nullptr;
+    const BuddyPcpBlock* held = nullptr;
+    const MigrateType* pageblocks = nullptr;
+    size_t list_count = 0, block_count = 0, allocated_count = 0;
+    size_t held_count = 0, pageblock_count = 0;
+
+    bool read(const CheckpointReader& in);
+    bool valid() const;
+};
+
+bool BuddySections::read(const CheckpointReader& in) {
+    lists = in.get<BuddyFreeList>(SectionId::BUDDY_FREE_LISTS, list_count);
+    blocks = in.get<BuddyBlock>(SectionId::BUDDY_FREE_BLOCKS, block_count);
+    allocated = in.get<BuddyAllocation>(SectionId::BUDDY_ALLOCATED, allocated_count);
+    held = in.get<BuddyPcpBlock>(SectionId::BUDDY_PCP, held_count);
+    pageblocks = in.get<MigrateType>(SectionId::BUDDY_PAGEBLOCKS, pageblock_count);
+    return in.get_value(SectionId::BUDDY_STATE, state) && lists && blocks && allocated
+        && held && pageblocks && valid();
+}
+
+static bool is_power_of_two(size_t n) {
+    return n && (n & (n - 1)) == 0;
+}
+
+static bool within(size_t start, size_t size, size_t total) {
+    return start <= total && size <= total - start;
+}
+
+// Every block inside the heap and on the list of its size, per-CPU
+// blocks on lists that exist, one type per pageblock
+bool BuddySections::valid() const {
+    const BuddyConfig& c = state.config;
+    size_t total = state.total_memory;
+    if (!is_power_of_two(state.min_block_size) || c.pcp_cpus > MAX_PCP_CPUS
+        || c.pcp_max_order >= 64 || state.current_type >= MigrateType::COUNT
+        || (c.pageblock_size && !is_power_of_two(c.pageblock_size)))
+        return false;
+
+    size_t pcp_count = c.pcp_cpus * (size_t)MigrateType::COUNT * (c.pcp_max_order + 1);
+    for (size_t i = 0; i < held_count; i++) {
+        if (held[i].list >= pcp_count || held[i].address >= total)
+            return false;
+    }
+
+    size_t pageblock_total = c.pageblock_size ? (total + c.pageblock_size - 1) / c.pageblock_size : 0;
+    if (pageblock_count != pageblock_total)
+        return false;
+    for (size_t i = 0; i < pageblock_count; i++) {
+        if (pageblocks[i] > MigrateType::COUNT)
+            return false;
+    }
+
+    size_t listed = 0;
+    for (size_t i = 0; i < list_count; i++) {
+        if (lists[i].count > block_count - listed)
+            return false;
+        for (size_t k = listed; k < listed + lists[i].count; k++) {
+            if (blocks[k].size != lists[i].size || !within(blocks[k].start, blocks[k].size, total))
+                return false;
+        }
+        listed += lists[i].count;
+    }
+    if (listed != block_count)
+        return false;
+
+    for (size_t i = 0; i < allocated_count; i++) {
+        const BuddyAllocation& a = allocated[i];
+        if (!is_power_of_two(a.block_size) || a.requested > a.block_size
+            || a.address % a.block_size != 0 || !within(a.address, a.block_size, total))
+            return false;
+    }
+    return true;
+}
+
+bool BuddyAllocator::can_load(const CheckpointReader& in) const {
+    BuddySections saved;
+    return saved.read(in);
+}
+
+bool BuddyAllocator::load(const CheckpointReader& in) {
+    BuddySections saved;
+    if (!saved.read(in))
+        return false;
+
+    const BuddyCheckpoint& state = saved.state;
+    total_memory = state.total_memory;
+    min_block_size = state.min_block_size;
+    successful_allocs = state.successful_allocs;
+    failed_allocs = state.failed_allocs;
+    internal_fragmentation = state.internal_fragmentation;
+    used_memory = state.used_memory;
+    total_requests = state.total_requests;
+    realloc_stats = state.realloc_stats;
+    config = state.config;
+    stats = state.stats;
+    current_cpu = state.current_cpu;
+    current_type = state.current_type;
+    pending_merges = state.pending_merges;
+
+    pcp_lists.assign(config.pcp_cpus * (size_t)MigrateType::COUNT * (config.pcp_max_order + 1), {});
+    for (size_t i = 0; i < saved.held_count; i++)
+        pcp_lists[saved.held[i].list].push_back(saved.held[i].address);
+    pcp_blocks = saved.held_count;
+    pageblock_types.assign(saved.pageblocks, saved.pageblocks + saved.pageblock_count);
+
+    free_lists.clear();
+    const BuddyBlock* blocks = saved.blocks;
+    for (size_t i = 0; i < saved.list_count; i++) {
+        free_lists[saved.lists[i].size].assign(blocks, blocks + saved.lists[i].count);
+        blocks += saved.lists[i].count;
+    }
+
+    allocated_blocks.clear();
+    allocated_blocks.reserve(saved.allocated_count);
+    for (size_t i = 0; i < saved.allocated_count; i++) {
+        const BuddyAllocation& a = saved.allocated[i];
+        allocated_blocks[a.address] = {a.block_size, a.requested};
+    }
+    return true;
 }
\ No newline at end of file
@@ -2,7 +2,13 @@
 #include <map>
 #include <vector>
 #include <cstddef>
+#include <cstdint>
+#include <ostream>
 #include <unordered_map>
+#include "../allocator/realloc_stats.h"
+
+class CheckpointWriter;
+class CheckpointReader;
 
 struct BuddyBlock {
     size_t start;
@@ -11,6 +17,53 @@ struct BuddyBlock {
     
 };
 
+// Pageblock groups for migrate-type grouping, as in Linux
+enum class MigrateType : uint8_t {
+    UNMOVABLE,
+    MOVABLE,
+    RECLAIMABLE,
+    COUNT
+};
+
+// Front ends in the style of the Linux page allocator. All off by
+// default, which is the plain eager buddy system.
+const size_t MAX_PCP_CPUS = 1024;
+
+struct BuddyConfig {
+    size_t pcp_cpus = 0;            // per-CPU lists, 0 = off, at most MAX_PCP_CPUS
+    size_t pcp_max_order = 3;       // larger orders bypass the lists
+    size_t pcp_batch = 8;           // blocks moved per refill or drain
+    size_t pcp_high = 32;           // drain a list once it holds more
+    bool lazy_merge = false;        // free without coalescing...
+    size_t merge_watermark = 64;    // ...until this many frees are pending
+    size_t pageblock_size = 0;      // migrate-type grouping, 0 = off
+};
+
+// Allocator work, to compare the front ends with the eager scheme
+struct BuddyStats {
+    size_t splits = 0;
+    size_t merges = 0;
+    size_t pcp_hits = 0;            // served from a per-CPU list
+    size_t pcp_refills = 0;
+    size_t pcp_drains = 0;
+    size_t coalesce_passes = 0;
+    size_t deferred_frees = 0;
+    size_t migrate_fallbacks = 0;   // served from another type's pageblock
+
+    void print(std::ostream& out) const {
+        out << "Splits: " << splits << "\n";
+        out << "Merges: " << merges << "\n";
+        if (pcp_hits || pcp_refills || pcp_drains)
+            out << "Per-CPU: " << pcp_hits << " hits, " << pcp_refills
+                << " refills, " << pcp_drains << " drains\n";
+        if (deferred_frees)
+            out << "Deferred frees: " << deferred_frees << ", coalesce passes: "
+                << coalesce_passes << "\n";
+        if (migrate_fallbacks)
+            out << "Migrate-type fallbacks: " << migrate_fallbacks << "\n";
+    }
+};
+
 class BuddyAllocator {
 public:
     BuddyAllocator();
@@ -18,12 +71,48 @@ public:
     int malloc_block(size_t size);
     void init(size_t size); 
     bool free_block(size_t address);
+    // Blocks are naturally aligned to their size, so alignment only
+    // raises the block size
+    int malloc_aligned(size_t size, size_t align);
+    // Grows in place by absorbing free buddies, shrinks by splitting off
+    // the upper halves. Returns the block address or -1.
+    int realloc_block(size_t address, size_t new_size);
     void dump() const;
     void print_stats() const;
     size_t get_used_memory() const { return used_memory; }
     size_t get_total_memory() const { return total_memory; }
     size_t get_failed_allocs() const { return failed_allocs; }
     size_t get_successful_allocs() const { return successful_allocs; }
+    size_t get_internal_fragmentation() const { return internal_fragmentation; }
+    size_t get_largest_free() const;
+    bool is_allocated(size_t address) const {
+        return allocated_blocks.count(address) != 0;
+    }
+    // Address of the allocated block covering address, or -1
+    long long block_at(size_t address) const;
+    size_t requested_size(size_t address) const {
+        auto found = allocated_blocks.find(address);
+        return found == allocated_blocks.end() ? 0 : found->second.second;
+    }
+
+    // Drains per-CPU lists and pending merges under the old settings
+    // first; the live blocks stay where they are
+    void configure(const BuddyConfig& config);
+    const BuddyConfig& get_config() const { return config; }
+    // CPU and migrate type of the allocations and frees that follow
+    void set_cpu(size_t cpu) { current_cpu = cpu; }
+    void set_migrate_type(MigrateType type) { current_type = type; }
+    // Returns every per-CPU block to the buddy lists and coalesces
+    void drain();
+    const BuddyStats& get_stats() const { return stats; }
+    void print_buddy_stats() const;
+
+    // Free lists and allocated map for a checkpoint. can_load() checks
+    // the sections and their values; load() changes nothing unless it
+    // passes.
+    void save(CheckpointWriter& out) const;
+    bool can_load(const CheckpointReader& in) const;
+    bool load(const CheckpointReader& in);
     
 
 private:
@@ -34,6 +123,18 @@ private:
     size_t internal_fragmentation = 0;
     size_t used_memory = 0;
     size_t total_requests = 0;
+    ReallocStats realloc_stats;
+    BuddyConfig config;
+    BuddyStats stats;
+    size_t current_cpu = 0;
+    MigrateType current_type = MigrateType::MOVABLE;
+    size_t pending_merges = 0;
+
+    // Per-CPU block addresses, indexed by pcp_index()
+    std::vector<std::vector<size_t>> pcp_lists;
+    size_t pcp_blocks = 0;
+    // Owner of each pageblock, COUNT while the pageblock is wholly free
+    std::vector<MigrateType> pageblock_types;
 
     std::unordered_map<size_t, std::pair<size_t, size_t>> allocated_blocks;
     std::map<size_t, std::vector<BuddyBlock>> free_lists;
@@ -41,4 +142,16 @@ private:
     size_t next_power_of_two(size_t n) const;
     size_t get_buddy_address(size_t addr, size_t size) const;
     void split_block(size_t size);
+    void free_upper_half(size_t start, size_t size);
+    int allocate(size_t block_size, size_t request_size);
+    long long take_block(size_t block_size);
+    long long take_grouped(size_t block_size);
+    void release(size_t address, size_t size);
+    void coalesce();
+    void setup_front_ends();
+    MigrateType type_at(size_t address) const;
+    void mark_pageblocks(size_t address, size_t size, MigrateType type);
+    bool pcp_order(size_t block_size, size_t& order) const;
+    size_t pcp_index(size_t order, MigrateType type) const;
+    bool take_free_block(size_t address, size_t size);
 };
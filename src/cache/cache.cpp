@@ -1,5 +1,8 @@
 #include "cache.h"
 #include <iostream>
+#include "../io/output.h"
+#include "../profile/profiler.h"
+#include "../checkpoint/checkpoint.h"
 
 Cache::Cache(size_t csize, size_t bsize, int latency)
     : cache_size(csize),
@@ -11,14 +14,30 @@ Cache::Cache(size_t csize, size_t bsize, int latency)
 
     num_lines = cache_size / block_size;
     lines.resize(num_lines, {false, 0, 0});
+    set_specialized(true);
+    reset_partitions();
 }
 
 bool Cache::access(size_t address) {
-    size_t block_addr = address / block_size;
+    MEMSIM_PROBE(CACHE_ACCESS);
     time_counter++;
 
+    if (engine) {
+        bool hit = engine->access(address, time_counter);
+        if (hit)
+            hits++;
+        else
+            misses++;
+        return hit;
+    }
+
+    size_t block_addr = address / block_size;
+    if (partitioned)
+        return access_partitioned(block_addr);
+
     // Check for HIT
     for (auto& line : lines) {
+        MEMSIM_COUNT(CACHE_LINES_SCANNED, 1);
         if (line.valid && line.tag == block_addr) {
             hits++;
             return true;
@@ -30,6 +49,7 @@ bool Cache::access(size_t address) {
 
     // Find empty line
     for (auto& line : lines) {
+        MEMSIM_COUNT(CACHE_LINES_SCANNED, 1);
         if (!line.valid) {
             line.valid = true;
             line.tag = block_addr;
@@ -41,6 +61,7 @@ bool Cache::access(size_t address) {
     // LRU/FIFO replacement
     auto victim = lines.begin();
     for (auto it = lines.begin(); it != lines.end(); ++it) {
+        MEMSIM_COUNT(CACHE_LINES_SCANNED, 1);
         if (it->arrival_time < victim->arrival_time) {
             victim = it;
         }
@@ -52,33 +73,278 @@ bool Cache::access(size_t address) {
     return false;
 }
 
+// Same as the generic loop, with fills restricted to the tenant's ways
+bool Cache::access_partitioned(size_t block_addr) {
+    TenantStats& tenant = tenants[current_tenant];
+
+    for (auto& line : lines) {
+        MEMSIM_COUNT(CACHE_LINES_SCANNED, 1);
+        if (line.valid && line.tag == block_addr) {
+            hits++;
+            tenant.hits++;
+            return true;
+        }
+    }
+
+    misses++;
+    tenant.misses++;
+
+    // An empty way in the mask first, else its oldest line
+    uint64_t mask = clos_masks[tenant.clos];
+    size_t victim = num_lines;
+    for (size_t i = 0; i < num_lines; i++) {
+        MEMSIM_COUNT(CACHE_LINES_SCANNED, 1);
+        if (!((mask >> way_of(i)) & 1))
+            continue;
+        if (!lines[i].valid) {
+            victim = i;
+            break;
+        }
+        if (victim == num_lines || lines[i].arrival_time < lines[victim].arrival_time)
+            victim = i;
+    }
+
+    lines[victim] = {true, block_addr, time_counter};
+    line_owner[victim] = current_tenant;
+    return false;
+}
+
+// Switches to the generic loop, which knows about masks and owners
+void Cache::partition() {
+    if (partitioned)
+        return;
+    engine_wanted = engine != nullptr;
+    set_specialized(false);
+    partitioned = true;
+}
+
+void Cache::set_tenant(int tenant) {
+    partition();
+    current_tenant = tenant;
+    tenants[tenant];
+}
+
+bool Cache::set_clos_mask(size_t clos, uint64_t mask) {
+    if (mask_bits() < 64)
+        mask &= ((uint64_t)1 << mask_bits()) - 1;
+    if (clos >= MAX_CLOS || mask == 0)
+        return false;
+    partition();
+    clos_masks[clos] = mask;
+    return true;
+}
+
+bool Cache::assign_clos(int tenant, size_t clos) {
+    if (clos >= MAX_CLOS)
+        return false;
+    partition();
+    tenants[tenant].clos = clos;
+    return true;
+}
+
+void Cache::reset_partitions() {
+    uint64_t all = mask_bits() < 64 ? ((uint64_t)1 << mask_bits()) - 1 : ~(uint64_t)0;
+    for (uint64_t& mask : clos_masks)
+        mask = all;
+    tenants.clear();
+    current_tenant = 0;
+    line_owner.assign(num_lines, -1);
+
+    if (partitioned) {
+        partitioned = false;
+        set_specialized(engine_wanted);
+    }
+}
+
+// The dynamic cache is fully associative with FIFO replacement, as is
+// every registered engine
+void Cache::set_specialized(bool enabled) {
+    if (partitioned) {
+        engine_wanted = enabled;
+        return;
+    }
+    if (enabled && !engine) {
+        engine = make_cache_engine(num_lines, block_size);
+        if (engine)
+            engine->import_lines(lines);
+    } else if (!enabled && engine) {
+        engine->export_lines(lines);
+        engine.reset();
+    }
+}
+
+std::vector<CacheLine> Cache::tag_array() const {
+    if (!engine)
+        return lines;
+    std::vector<CacheLine> current;
+    engine->export_lines(current);
+    return current;
+}
+
 int Cache::get_latency() const {
     return access_latency;
 }
 
 void Cache::print_stats() const {
-    std::cout << "Cache hits: " << hits << "\n";
-    std::cout << "Cache misses: " << misses << "\n";
+    std::ostream& out = Output::stream();
+
+    out << "Cache hits: " << hits << "\n";
+    out << "Cache misses: " << misses << "\n";
 
     if (hits + misses > 0) {
         double hit_ratio =
             (double)hits / (hits + misses) * 100.0;
-        std::cout << "Hit ratio: " << hit_ratio << "%\n";
+        out << "Hit ratio: " << hit_ratio << "%\n";
+    }
+}
+
+void Cache::print_tenant_stats() const {
+    std::ostream& out = Output::stream();
+
+    if (tenants.empty()) {
+        out << "No tenants\n";
+        return;
+    }
+
+    std::map<int, size_t> occupancy;
+    for (size_t i = 0; i < num_lines; i++) {
+        if (lines[i].valid && line_owner[i] != -1)
+            occupancy[line_owner[i]]++;
+    }
+
+    for (const auto& [id, tenant] : tenants) {
+        out << "Tenant " << id << ": CLOS " << tenant.clos << ", ways 0x"
+            << std::hex << clos_masks[tenant.clos] << std::dec << ", "
+            << tenant.hits << " hits, " << tenant.misses << " misses";
+        if (tenant.hits + tenant.misses > 0)
+            out << ", hit ratio "
+                << (double)tenant.hits / (tenant.hits + tenant.misses) * 100.0 << "%";
+        out << ", occupancy " << occupancy[id] << "/" << num_lines << " lines\n";
     }
 }
 
 void Cache::dump() const {
-    std::cout << "===== Cache Dump =====\n";
+    std::ostream& out = Output::stream();
+
+    out << "===== Cache Dump =====\n";
+    std::vector<CacheLine> current = tag_array();
 
-    for (size_t i = 0; i < lines.size(); ++i) {
-        std::cout << "Line " << i << ": ";
+    for (size_t i = 0; i < current.size(); ++i) {
+        out << "Line " << i << ": ";
 
-        if (lines[i].valid) {
-            std::cout << "VALID  tag=" << lines[i].tag;
+        if (current[i].valid) {
+            out << "VALID  tag=" << current[i].tag;
         } else {
-            std::cout << "INVALID";
+            out << "INVALID";
         }
 
-        std::cout << "\n";
+        out << "\n";
+    }
+}
+
+struct CacheCheckpoint {
+    size_t cache_size;
+    size_t block_size;
+    size_t num_lines;
+    int access_latency;
+    size_t time_counter;
+    size_t hits;
+    size_t misses;
+};
+
+void Cache::save(CheckpointWriter& out, SectionId state, SectionId tags) const {
+    out.add_value(state, CacheCheckpoint {cache_size, block_size, num_lines,
+                                          access_latency, time_counter, hits, misses});
+    out.add(tags, tag_array());
+}
+
+// The geometry must be one the constructor could have built
+static bool read_cache(const CheckpointReader& in, SectionId state, SectionId tags,
+                       CacheCheckpoint& saved, const CacheLine*& saved_lines) {
+    size_t count = 0;
+    saved_lines = in.get<CacheLine>(tags, count);
+    return in.get_value(state, saved) && saved_lines && count == saved.num_lines &&
+           saved.block_size > 0 && saved.num_lines == saved.cache_size / saved.block_size;
+}
+
+bool Cache::can_load(const CheckpointReader& in, SectionId state, SectionId tags) const {
+    CacheCheckpoint saved;
+    const CacheLine* saved_lines;
+    return read_cache(in, state, tags, saved, saved_lines);
+}
+
+bool Cache::load(const CheckpointReader& in, SectionId state, SectionId tags) {
+    CacheCheckpoint saved;
+    const CacheLine* saved_lines;
+    if (!read_cache(in, state, tags, saved, saved_lines))
+        return false;
+
+    cache_size = saved.cache_size;
+    block_size = saved.block_size;
+    num_lines = saved.num_lines;
+    access_latency = saved.access_latency;
+    time_counter = saved.time_counter;
+    hits = saved.hits;
+    misses = saved.misses;
+    lines.assign(saved_lines, saved_lines + num_lines);
+    // Partitions are configuration, not state: they stay, but who filled
+    // the restored lines is unknown
+    line_owner.assign(num_lines, -1);
+
+    // The geometry may have changed
+    bool specialized = partitioned ? engine_wanted : engine != nullptr;
+    engine.reset();
+    set_specialized(specialized);
+    return true;
+}
+
+// Registry of compiled-in geometries: the simulator's own L1 and L2 and
+// the usual power-of-two sizes, up to 512 lines
+namespace {
+
+using CacheFactory = std::unique_ptr<CacheEngine> (*)();
+
+struct CacheGeometry {
+    size_t lines;
+    size_t line_bytes;
+    CacheFactory make;
+};
+
+template <size_t Lines, size_t LineBytes>
+CacheGeometry entry() {
+    return {Lines, LineBytes,
+            [] { return std::unique_ptr<CacheEngine>(new StaticCache<Lines, LineBytes>()); }};
+}
+
+template <size_t LineBytes>
+void add_line_counts(std::vector<CacheGeometry>& out) {
+    out.push_back(entry<4, LineBytes>());
+    out.push_back(entry<8, LineBytes>());
+    out.push_back(entry<16, LineBytes>());
+    out.push_back(entry<32, LineBytes>());
+    out.push_back(entry<64, LineBytes>());
+    out.push_back(entry<128, LineBytes>());
+    out.push_back(entry<256, LineBytes>());
+    out.push_back(entry<512, LineBytes>());
+}
+
+const std::vector<CacheGeometry>& cache_registry() {
+    static const std::vector<CacheGeometry> registry = [] {
+        std::vector<CacheGeometry> out;
+        add_line_counts<16>(out);
+        add_line_counts<32>(out);
+        add_line_counts<64>(out);
+        return out;
+    }();
+    return registry;
+}
+
+}
+
+std::unique_ptr<CacheEngine> make_cache_engine(size_t lines, size_t line_bytes) {
+    for (const CacheGeometry& g : cache_registry()) {
+        if (g.lines == lines && g.line_bytes == line_bytes)
+            return g.make();
     }
+    return nullptr;
 }
@@ -1,11 +1,11 @@
+#pragma once
 #include <bits/stdc++.h>
+#include "static_cache.h"
 using namespace std;
 
-struct CacheLine {
-    bool valid;
-    size_t tag;
-    size_t arrival_time;
-};
+class CheckpointWriter;
+class CheckpointReader;
+enum class SectionId : uint32_t;
 
 class Cache {
 public:
@@ -16,6 +16,38 @@ public:
     int get_latency() const;      // returns last access latency
     void dump() const;
 
+    size_t get_hits() const { return hits; }
+    size_t get_misses() const { return misses; }
+    size_t get_block_size() const { return block_size; }
+
+    // Runs accesses through a compile-time specialized engine when one
+    // matches this geometry (the default); off uses the generic loop.
+    // A partitioned cache always uses the generic loop.
+    void set_specialized(bool enabled);
+    bool is_specialized() const { return engine != nullptr; }
+
+    // Intel CAT-style way partitioning. Each tenant belongs to a class of
+    // service (CLOS 0 unless assigned) and fills only the ways in its
+    // mask; lookups still hit in any way. The cache is fully associative,
+    // so ways are lines, grouped into mask_bits() bits. Any of these calls
+    // turns on per-tenant hit counts and occupancy.
+    static const size_t MAX_CLOS = 16;
+    void set_tenant(int tenant);
+    // False for an unknown CLOS or a mask with no ways in this cache
+    bool set_clos_mask(size_t clos, uint64_t mask);
+    bool assign_clos(int tenant, size_t clos);
+    // Back to one shared cache without tenant accounting
+    void reset_partitions();
+    bool is_partitioned() const { return partitioned; }
+    size_t mask_bits() const { return std::min<size_t>(num_lines, 64); }
+    void print_tenant_stats() const;
+
+    // Geometry, counters and the tag array, under the given sections.
+    // load() changes nothing unless can_load() would pass.
+    void save(CheckpointWriter& out, SectionId state, SectionId tags) const;
+    bool can_load(const CheckpointReader& in, SectionId state, SectionId tags) const;
+    bool load(const CheckpointReader& in, SectionId state, SectionId tags);
+
 private:
     size_t cache_size;
     size_t block_size;
@@ -26,5 +58,23 @@ private:
     size_t hits;
     size_t misses;
 
-    std::vector<CacheLine> lines;
+    std::vector<CacheLine> lines;     // only current while engine is null
+    std::unique_ptr<CacheEngine> engine;
+
+    struct TenantStats {
+        size_t clos = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+    bool partitioned = false;
+    bool engine_wanted = false;       // restored by reset_partitions()
+    int current_tenant = 0;
+    uint64_t clos_masks[MAX_CLOS];
+    std::map<int, TenantStats> tenants;
+    std::vector<int> line_owner;      // tenant that filled each line, -1 if none
+
+    std::vector<CacheLine> tag_array() const;
+    void partition();
+    bool access_partitioned(size_t block_addr);
+    size_t way_of(size_t line) const { return line * mask_bits() / num_lines; }
 };
\ No newline at end of file
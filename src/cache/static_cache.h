@@ -0,0 +1,97 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+struct CacheLine {
+    bool valid;
+    size_t tag;
+    size_t arrival_time;
+};
+
+// A cache with its geometry fixed at compile time, behind the one
+// virtual call per access that lets Cache pick it at runtime
+class CacheEngine {
+public:
+    virtual ~CacheEngine() = default;
+    // now is the caller's access counter, used as the replacement stamp
+    virtual bool access(size_t address, size_t now) = 0;
+
+    // Lines in the dynamic engine's order
+    virtual void export_lines(std::vector<CacheLine>& lines) const = 0;
+    virtual void import_lines(const std::vector<CacheLine>& lines) = 0;
+};
+
+constexpr bool is_power_of_two(size_t n) {
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+constexpr unsigned log2_of(size_t n) {
+    return n <= 1 ? 0 : 1 + log2_of(n >> 1);
+}
+
+// Fully associative, Lines lines of LineBytes, both powers of two, with
+// FIFO replacement, as Cache: the block address is a shift and the ways
+// fixed-size arrays the compiler can unroll. Tags hold the whole block
+// address, as in Cache.
+template <size_t Lines, size_t LineBytes>
+class StaticCache final : public CacheEngine {
+    static_assert(is_power_of_two(Lines) && is_power_of_two(LineBytes),
+                  "geometry must be powers of two");
+    static_assert(LineBytes > 1, "the all-ones tag marks an invalid way");
+
+public:
+    static constexpr unsigned LINE_SHIFT = log2_of(LineBytes);
+
+    StaticCache() {
+        tags.fill(INVALID);
+        stamps.fill(0);
+    }
+
+    bool access(size_t address, size_t now) override {
+        size_t block = address >> LINE_SHIFT;
+
+        // Hits leave the fill time alone
+        for (size_t w = 0; w < Lines; w++) {
+            if (tags[w] == block)
+                return true;
+        }
+
+        // Invalid ways have stamp 0 and now starts at 1, so the oldest
+        // stamp is the first invalid way if there is one
+        size_t victim = 0;
+        for (size_t w = 1; w < Lines; w++) {
+            if (stamps[w] < stamps[victim])
+                victim = w;
+        }
+        tags[victim] = block;
+        stamps[victim] = now;
+        return false;
+    }
+
+    void export_lines(std::vector<CacheLine>& lines) const override {
+        lines.clear();
+        for (size_t w = 0; w < Lines; w++) {
+            bool valid = tags[w] != INVALID;
+            lines.push_back({valid, valid ? tags[w] : 0, stamps[w]});
+        }
+    }
+
+    void import_lines(const std::vector<CacheLine>& lines) override {
+        for (size_t w = 0; w < Lines && w < lines.size(); w++) {
+            tags[w] = lines[w].valid ? lines[w].tag : INVALID;
+            stamps[w] = lines[w].valid ? lines[w].arrival_time : 0;
+        }
+    }
+
+private:
+    static constexpr size_t INVALID = ~(size_t)0;
+
+    // Tags and stamps kept apart so the hit scan reads only tags
+    std::array<size_t, Lines> tags;
+    std::array<size_t, Lines> stamps;
+};
+
+// Specialized engine for a geometry, or nullptr if none is compiled in
+std::unique_ptr<CacheEngine> make_cache_engine(size_t lines, size_t line_bytes);
@@ -0,0 +1,141 @@
+#include "checkpoint.h"
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+uint32_t checkpoint_layout() {
+    const uint32_t probe = 0x01020304;
+    uint8_t first;
+    std::memcpy(&first, &probe, 1);
+    return (uint32_t)sizeof(void*) << 8 | first;
+}
+
+void CheckpointWriter::add_raw(SectionId id, size_t record_bytes,
+                               const void* records, size_t bytes) {
+    size_t offset = payload.size();
+    payload.resize(align8(offset + bytes));
+    if (bytes > 0)
+        std::memcpy(payload.data() + offset, records, bytes);
+    sections.push_back({id, (uint32_t)record_bytes, offset, bytes});
+}
+
+bool CheckpointWriter::save(const std::string& path) {
+    FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out)
+        return false;
+
+    // Section offsets are relative to the payload until now
+    size_t base = align8(sizeof(CheckpointHeader) +
+                         sections.size() * sizeof(CheckpointSection));
+    std::vector<CheckpointSection> table = sections;
+    for (CheckpointSection& s : table)
+        s.offset += base;
+
+    CheckpointHeader header {CHECKPOINT_MAGIC, CHECKPOINT_VERSION,
+                             (uint32_t)table.size(), checkpoint_layout(),
+                             base + payload.size()};
+
+    static const uint8_t zeros[8] = {};
+    size_t table_end = sizeof(header) + table.size() * sizeof(CheckpointSection);
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+              std::fwrite(table.data(), sizeof(CheckpointSection), table.size(), out) == table.size() &&
+              std::fwrite(zeros, 1, base - table_end, out) == base - table_end &&
+              std::fwrite(payload.data(), 1, payload.size(), out) == payload.size();
+    ok = std::fclose(out) == 0 && ok;
+
+    written = ok ? header.file_bytes : 0;
+    return ok;
+}
+
+CheckpointReader::~CheckpointReader() {
+    close();
+}
+
+bool CheckpointReader::open(const std::string& path) {
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CheckpointHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    data = static_cast<const uint8_t*>(map);
+    length = st.st_size;
+    mapped = true;
+#else
+    FILE* in = std::fopen(path.c_str(), "rb");
+    if (!in)
+        return false;
+    uint8_t chunk[1 << 16];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), in)) > 0)
+        buffer.insert(buffer.end(), chunk, chunk + n);
+    std::fclose(in);
+    data = buffer.data();
+    length = buffer.size();
+#endif
+
+    // Everything get() relies on is checked once here
+    CheckpointHeader header;
+    bool ok = length >= sizeof(header);
+    if (ok) {
+        std::memcpy(&header, data, sizeof(header));
+        ok = header.magic == CHECKPOINT_MAGIC &&
+             header.version == CHECKPOINT_VERSION &&
+             header.layout == checkpoint_layout() &&
+             header.file_bytes == length &&
+             sizeof(header) + (uint64_t)header.sections * sizeof(CheckpointSection) <= length;
+    }
+    for (uint32_t i = 0; ok && i < header.sections; i++) {
+        const CheckpointSection& s = reinterpret_cast<const CheckpointSection*>(
+            data + sizeof(header))[i];
+        ok = s.record_bytes > 0 && s.offset % 8 == 0 &&
+             s.offset <= length && s.bytes <= length - s.offset &&
+             s.bytes % s.record_bytes == 0;
+    }
+    if (!ok)
+        close();
+    return ok;
+}
+
+void CheckpointReader::close() {
+#ifndef _WIN32
+    if (mapped)
+        munmap(const_cast<uint8_t*>(data), length);
+#endif
+    mapped = false;
+    data = nullptr;
+    length = 0;
+    buffer.clear();
+}
+
+const CheckpointSection* CheckpointReader::find(SectionId id) const {
+    if (!data)
+        return nullptr;
+    const CheckpointHeader* header = reinterpret_cast<const CheckpointHeader*>(data);
+    const CheckpointSection* table = reinterpret_cast<const CheckpointSection*>(
+        data + sizeof(CheckpointHeader));
+    for (uint32_t i = 0; i < header->sections; i++) {
+        if (table[i].id == id)
+            return &table[i];
+    }
+    return nullptr;
+}
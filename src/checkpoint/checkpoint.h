@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary snapshot of the simulator state.
+//
+// File:    CheckpointHeader, section table, then the sections, each
+//          starting on an 8-byte boundary.
+// Section: a flat array of trivially copyable records, laid out exactly
+//          as in memory, so the file can be mapped and vectors restored
+//          with one copy. Checkpoints are only portable between builds
+//          with the same record layouts, which the header checks.
+
+enum class SectionId : uint32_t {
+    MEMORY_STATE = 1,
+    MEMORY_BLOCKS,
+    MEMORY_RELOCATIONS,
+    COMPACTION_HISTORY,
+    BUDDY_STATE,
+    BUDDY_FREE_LISTS,
+    BUDDY_FREE_BLOCKS,
+    BUDDY_ALLOCATED,
+    L1_STATE,
+    L1_LINES,
+    L2_STATE,
+    L2_LINES,
+    TLB_STATE,
+    TLB_ENTRIES,
+    VM_STATE,
+    VM_FRAMES,
+    VM_PAGES,
+    VM_FIFO,
+    VM_LRU,
+    TIER_STATE,
+    TIER_HEAT,
+    SWAP_STATE,
+    SWAP_SLOTS,
+    BUDDY_PCP,
+    BUDDY_PAGEBLOCKS
+};
+
+const uint32_t CHECKPOINT_MAGIC = 0x4b43534d;  // "MSCK"
+const uint32_t CHECKPOINT_VERSION = 3;
+
+struct CheckpointHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sections;
+    uint32_t layout;        // checkpoint_layout() of the writing build
+    uint64_t file_bytes;
+};
+
+struct CheckpointSection {
+    SectionId id;
+    uint32_t record_bytes;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+// Fingerprint of word size and byte order
+uint32_t checkpoint_layout();
+
+class CheckpointWriter {
+public:
+    template <typename T>
+    void add(SectionId id, const T* records, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        add_raw(id, sizeof(T), records, count * sizeof(T));
+    }
+    template <typename T>
+    void add(SectionId id, const std::vector<T>& records) {
+        add(id, records.data(), records.size());
+    }
+    template <typename T>
+    void add_value(SectionId id, const T& value) {
+        add(id, &value, 1);
+    }
+
+    bool save(const std::string& path);
+
+    size_t section_count() const { return sections.size(); }
+    size_t bytes_written() const { return written; }
+
+private:
+    std::vector<CheckpointSection> sections;
+    std::vector<uint8_t> payload;
+    size_t written = 0;
+
+    void add_raw(SectionId id, size_t record_bytes, const void* data, size_t bytes);
+};
+
+// Maps a checkpoint and hands out its sections in place
+class CheckpointReader {
+public:
+    CheckpointReader() = default;
+    ~CheckpointReader();
+    CheckpointReader(const CheckpointReader&) = delete;
+    CheckpointReader& operator=(const CheckpointReader&) = delete;
+
+    // Fails on a missing, truncated or foreign file
+    bool open(const std::string& path);
+    void close();
+
+    // Records of one section, or nullptr if it is missing or was written
+    // with a different record size
+    template <typename T>
+    const T* get(SectionId id, size_t& count) const {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const CheckpointSection* s = find(id);
+        if (!s || s->record_bytes != sizeof(T))
+            return nullptr;
+        count = s->bytes / sizeof(T);
+        return reinterpret_cast<const T*>(data + s->offset);
+    }
+    template <typename T>
+    bool get_value(SectionId id, T& value) const {
+        size_t count;
+        const T* p = get<T>(id, count);
+        if (!p || count != 1)
+            return false;
+        value = *p;
+        return true;
+    }
+
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::vector<uint8_t> buffer;    // used where mmap isn't available
+
+    const CheckpointSection* find(SectionId id) const;
+};
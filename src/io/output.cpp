@@ -0,0 +1,59 @@
+#include "output.h"
+#include <cstdio>
+
+namespace {
+
+class BufferedSink : public std::streambuf {
+public:
+    BufferedSink() { setp(buffer, buffer + sizeof(buffer)); }
+    ~BufferedSink() override { sync(); }
+
+protected:
+    int_type overflow(int_type ch) override {
+        write_out();
+        if (ch != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        if (n > epptr() - pptr()) {
+            write_out();
+            if (n > epptr() - pptr()) {
+                std::fwrite(s, 1, n, stdout);
+                return n;
+            }
+        }
+        std::char_traits<char>::copy(pptr(), s, n);
+        pbump((int)n);
+        return n;
+    }
+
+    int sync() override {
+        write_out();
+        std::fflush(stdout);
+        return 0;
+    }
+
+private:
+    char buffer[1 << 16];
+
+    void write_out() {
+        std::fwrite(pbase(), 1, pptr() - pbase(), stdout);
+        setp(buffer, buffer + sizeof(buffer));
+    }
+};
+
+} // namespace
+
+std::ostream& Output::stream() {
+    static BufferedSink sink;
+    static std::ostream out(&sink);
+    return out;
+}
+
+void Output::flush() {
+    stream().flush();
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <ostream>
+
+// How much the simulator prints:
+//   QUIET   - only what stats/dump commands ask for
+//   SUMMARY - plus prompts and one line per command
+//   TRACE   - plus per-access detail (TLB, page table, cache levels)
+enum class Verbosity {
+    QUIET,
+    SUMMARY,
+    TRACE
+};
+
+// Levels above this are compiled out entirely
+#ifndef MEMSIM_MAX_VERBOSITY
+#define MEMSIM_MAX_VERBOSITY Verbosity::TRACE
+#endif
+
+// Single buffered sink for everything the simulator prints. Output goes
+// to stdout in large chunks instead of one write per line.
+class Output {
+public:
+    static std::ostream& stream();
+    static void flush();
+
+    static void set_verbosity(Verbosity level) { verbosity = level; }
+    static Verbosity get_verbosity() { return verbosity; }
+    static bool enabled(Verbosity level) {
+        return level <= MEMSIM_MAX_VERBOSITY && level <= verbosity;
+    }
+
+private:
+    static inline Verbosity verbosity = Verbosity::TRACE;
+};
+
+#define MEMSIM_LOG(level, expr) \
+    do { if (Output::enabled(level)) Output::stream() << expr; } while (0)
+
+#define MEMSIM_SUMMARY(expr) MEMSIM_LOG(Verbosity::SUMMARY, expr)
+#define MEMSIM_TRACE(expr)   MEMSIM_LOG(Verbosity::TRACE, expr)
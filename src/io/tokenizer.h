@@ -0,0 +1,51 @@
+#pragma once
+#include <charconv>
+#include <cstddef>
+#include <string_view>
+
+// Splits a command line into whitespace separated tokens without copying.
+// Views stay valid as long as the underlying line does.
+class Tokenizer {
+public:
+    explicit Tokenizer(std::string_view line) : rest(line) {}
+
+    // Returns the next token, or an empty view at end of line
+    std::string_view next() {
+        size_t begin = rest.find_first_not_of(" \t\r\n");
+        if (begin == std::string_view::npos) {
+            rest = {};
+            return {};
+        }
+        size_t end = rest.find_first_of(" \t\r\n", begin);
+        if (end == std::string_view::npos)
+            end = rest.size();
+
+        std::string_view token = rest.substr(begin, end - begin);
+        rest.remove_prefix(end);
+        return token;
+    }
+
+    // Parses the next token as a number. On failure value is set to 0,
+    // matching what stream extraction did.
+    template <typename T>
+    bool next_number(T& value) {
+        return parse_number(next(), value);
+    }
+
+    template <typename T>
+    static bool parse_number(std::string_view token, T& value) {
+        auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+        if (token.empty() || ec != std::errc() || ptr != token.data() + token.size()) {
+            value = 0;
+            return false;
+        }
+        return true;
+    }
+
+    bool done() const {
+        return rest.find_first_not_of(" \t\r\n") == std::string_view::npos;
+    }
+
+private:
+    std::string_view rest;
+};
@@ -0,0 +1,232 @@
+// LD_PRELOAD library that logs malloc/free/realloc/calloc/posix_memalign
+// calls of a running program for replay in memsim:
+//
+//   MEMSIM_ALLOC_TRACE=app.alloc LD_PRELOAD=./libmemsim_record.so ./app
+//   echo "trace import app.alloc app.mstr" | ./memsim
+//
+// Events go into a per-thread buffer and are written with one write()
+// per full buffer, so the hooks never allocate and threads share nothing.
+// realloc frees one block and takes another, so it is logged twice: the
+// old pointer is stamped before the real realloc can release it, the new
+// one after it returns. A block the realloc frees can only be handed to
+// another thread after the first stamp; the importer pairs the two per
+// thread.
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../trace/alloc_event.h"
+
+namespace {
+
+typedef void* (*malloc_fn)(size_t);
+typedef void  (*free_fn)(void*);
+typedef void* (*realloc_fn)(void*, size_t);
+typedef void* (*calloc_fn)(size_t, size_t);
+typedef int   (*memalign_fn)(void**, size_t, size_t);
+
+malloc_fn   real_malloc;
+free_fn     real_free;
+realloc_fn  real_realloc;
+calloc_fn   real_calloc;
+memalign_fn real_posix_memalign;
+
+int trace_fd = -1;
+pthread_key_t flush_key;
+bool initializing;
+
+// dlsym itself may calloc before the real functions are known
+char bootstrap_heap[4096];
+size_t bootstrap_used;
+
+const int BUFFER_EVENTS = 512;
+
+struct ThreadBuffer {
+    AllocEvent events[BUFFER_EVENTS];
+    int count;
+    uint32_t thread;
+    bool registered;
+    bool exiting;       // flushed at exit: write each later event at once
+};
+
+__attribute__((tls_model("initial-exec"))) thread_local ThreadBuffer buffer;
+__attribute__((tls_model("initial-exec"))) thread_local bool in_hook;
+
+void flush(ThreadBuffer* buf) {
+    if (buf->count == 0 || trace_fd < 0)
+        return;
+
+    const char* data = (const char*)buf->events;
+    size_t left = buf->count * sizeof(AllocEvent);
+    while (left > 0) {
+        ssize_t n = write(trace_fd, data, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        data += n;
+        left -= n;
+    }
+    buf->count = 0;
+}
+
+// Other key destructors may still allocate after this one has run
+void flush_at_thread_exit(void* buf) {
+    ((ThreadBuffer*)buf)->exiting = true;
+    flush((ThreadBuffer*)buf);
+}
+
+void init() {
+    initializing = true;
+    real_malloc = (malloc_fn)dlsym(RTLD_NEXT, "malloc");
+    real_free = (free_fn)dlsym(RTLD_NEXT, "free");
+    real_realloc = (realloc_fn)dlsym(RTLD_NEXT, "realloc");
+    real_calloc = (calloc_fn)dlsym(RTLD_NEXT, "calloc");
+    real_posix_memalign = (memalign_fn)dlsym(RTLD_NEXT, "posix_memalign");
+    initializing = false;
+
+    char path[256];
+    const char* env = getenv("MEMSIM_ALLOC_TRACE");
+    if (env) {
+        snprintf(path, sizeof(path), "%s", env);
+    } else {
+        snprintf(path, sizeof(path), "memsim_alloc.%d.trace", (int)getpid());
+    }
+
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (trace_fd >= 0) {
+        uint32_t header[2] = {ALLOC_LOG_MAGIC, ALLOC_LOG_VERSION};
+        if (write(trace_fd, header, sizeof(header)) != sizeof(header)) {
+            close(trace_fd);
+            trace_fd = -1;
+        }
+    }
+    pthread_key_create(&flush_key, flush_at_thread_exit);
+}
+
+inline void ensure_init() {
+    if (!real_malloc && !initializing)
+        init();
+}
+
+uint64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void record(uint32_t op, const void* ptr, uint64_t arg, uint64_t size) {
+    if (in_hook || trace_fd < 0)
+        return;
+    in_hook = true;
+
+    ThreadBuffer* buf = &buffer;
+    if (!buf->registered) {
+        buf->registered = true;
+        buf->thread = (uint32_t)syscall(SYS_gettid);
+        pthread_setspecific(flush_key, buf);
+    }
+
+    AllocEvent& e = buf->events[buf->count++];
+    e.time_ns = now_ns();
+    e.ptr = (uint64_t)ptr;
+    e.arg = arg;
+    e.size = size;
+    e.thread = buf->thread;
+    e.op = op;
+
+    if (buf->count == BUFFER_EVENTS || buf->exiting)
+        flush(buf);
+    in_hook = false;
+}
+
+bool from_bootstrap(const void* p) {
+    return p >= bootstrap_heap && p < bootstrap_heap + sizeof(bootstrap_heap);
+}
+
+void* bootstrap_alloc(size_t n) {
+    n = (n + 15) & ~(size_t)15;
+    if (bootstrap_used + n > sizeof(bootstrap_heap))
+        return nullptr;
+    void* p = bootstrap_heap + bootstrap_used;
+    bootstrap_used += n;
+    return p;
+}
+
+__attribute__((constructor)) void init_early() {
+    ensure_init();
+}
+
+__attribute__((destructor)) void flush_main_thread() {
+    buffer.exiting = true;
+    flush(&buffer);
+}
+
+} // namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+    ensure_init();
+    if (!real_malloc)
+        return bootstrap_alloc(size);
+
+    void* p = real_malloc(size);
+    record(EVENT_MALLOC, p, 0, size);
+    return p;
+}
+
+void free(void* ptr) {
+    if (!ptr || from_bootstrap(ptr))
+        return;
+    ensure_init();
+
+    record(EVENT_FREE, ptr, 0, 0);
+    real_free(ptr);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+    ensure_init();
+    if (!real_calloc)
+        return bootstrap_alloc(nmemb * size);   // zeroed static storage
+
+    void* p = real_calloc(nmemb, size);
+    record(EVENT_CALLOC, p, nmemb, nmemb * size);
+    return p;
+}
+
+void* realloc(void* ptr, size_t size) {
+    ensure_init();
+    if (from_bootstrap(ptr)) {
+        void* p = real_malloc(size);
+        if (p) {
+            size_t avail = bootstrap_heap + sizeof(bootstrap_heap) - (char*)ptr;
+            memcpy(p, ptr, size < avail ? size : avail);
+        }
+        record(EVENT_MALLOC, p, 0, size);
+        return p;
+    }
+
+    record(EVENT_REALLOC_START, ptr, 0, size);
+    void* p = real_realloc(ptr, size);
+    record(EVENT_REALLOC, p, (uint64_t)ptr, size);
+    return p;
+}
+
+int posix_memalign(void** memptr, size_t alignment, size_t size) {
+    ensure_init();
+    int rc = real_posix_memalign(memptr, alignment, size);
+    if (rc == 0)
+        record(EVENT_MEMALIGN, *memptr, alignment, size);
+    return rc;
+}
+
+}
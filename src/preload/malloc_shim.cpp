@@ -0,0 +1,272 @@
+// LD_PRELOAD library that serves a program's malloc family from a memsim
+// arena, so an allocation policy can be tried on a real program:
+//
+//   MEMSIM_ARENA_POLICY=best_fit MEMSIM_ARENA_SIZE=512m LD_PRELOAD=./libmemsim_malloc.so ./app
+//
+// MEMSIM_ARENA_POLICY is first_fit (default), best_fit, worst_fit or buddy;
+// MEMSIM_ARENA_SIZE takes k/m/g suffixes (default 256m). With
+// MEMSIM_ARENA_STATS=1 a summary goes to stderr at exit.
+//
+// One lock serializes the arena. The allocator's own bookkeeping is
+// allocated while that lock is held and goes to the real malloc, as does
+// anything the arena cannot fit.
+
+#include <dlfcn.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "../arena/arena.h"
+
+namespace {
+
+typedef void* (*malloc_fn)(size_t);
+typedef void  (*free_fn)(void*);
+typedef void* (*realloc_fn)(void*, size_t);
+typedef void* (*calloc_fn)(size_t, size_t);
+typedef int   (*memalign_fn)(void**, size_t, size_t);
+typedef size_t (*usable_size_fn)(void*);
+
+malloc_fn      real_malloc;
+free_fn        real_free;
+realloc_fn     real_realloc;
+calloc_fn      real_calloc;
+memalign_fn    real_posix_memalign;
+usable_size_fn real_usable_size;
+
+bool initializing;
+pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+
+alignas(Arena) unsigned char arena_storage[sizeof(Arena)];
+Arena* arena;
+size_t fallbacks;       // allocations the arena had no room for
+bool print_stats;
+
+// dlsym itself may calloc before the real functions are known
+char bootstrap_heap[4096];
+size_t bootstrap_used;
+
+__attribute__((tls_model("initial-exec"))) thread_local bool in_arena;
+
+size_t parse_size(const char* text, size_t fallback) {
+    if (!text)
+        return fallback;
+    char* end;
+    unsigned long long n = strtoull(text, &end, 10);
+    switch (*end) {
+    case 'k': case 'K': n <<= 10; break;
+    case 'm': case 'M': n <<= 20; break;
+    case 'g': case 'G': n <<= 30; break;
+    }
+    return n ? n : fallback;
+}
+
+AllocatorType parse_policy(const char* text) {
+    if (text && strcmp(text, "best_fit") == 0)  return AllocatorType::BEST_FIT;
+    if (text && strcmp(text, "worst_fit") == 0) return AllocatorType::WORST_FIT;
+    if (text && strcmp(text, "buddy") == 0)     return AllocatorType::BUDDY;
+    return AllocatorType::FIRST_FIT;
+}
+
+void init() {
+    initializing = true;
+    real_malloc = (malloc_fn)dlsym(RTLD_NEXT, "malloc");
+    real_free = (free_fn)dlsym(RTLD_NEXT, "free");
+    real_realloc = (realloc_fn)dlsym(RTLD_NEXT, "realloc");
+    real_calloc = (calloc_fn)dlsym(RTLD_NEXT, "calloc");
+    real_posix_memalign = (memalign_fn)dlsym(RTLD_NEXT, "posix_memalign");
+    real_usable_size = (usable_size_fn)dlsym(RTLD_NEXT, "malloc_usable_size");
+    initializing = false;
+
+    in_arena = true;
+    arena = new (arena_storage) Arena(parse_size(getenv("MEMSIM_ARENA_SIZE"), 256 << 20),
+                                      parse_policy(getenv("MEMSIM_ARENA_POLICY")));
+    print_stats = getenv("MEMSIM_ARENA_STATS") != nullptr;
+    in_arena = false;
+}
+
+inline void ensure_init() {
+    if (!real_malloc && !initializing)
+        init();
+}
+
+// Runs op on the arena under the lock, unless this thread is already
+// inside it (bookkeeping allocations) or the arena failed to map
+template <typename Op>
+bool with_arena(Op op) {
+    if (in_arena || !arena || !arena->valid())
+        return false;
+    pthread_mutex_lock(&arena_lock);
+    in_arena = true;
+    op(*arena);
+    in_arena = false;
+    pthread_mutex_unlock(&arena_lock);
+    return true;
+}
+
+void* arena_alloc(size_t size, size_t align) {
+    void* p = nullptr;
+    with_arena([&](Arena& a) {
+        p = a.alloc_aligned(size, align);
+        if (!p)
+            fallbacks++;
+    });
+    return p;
+}
+
+bool in_region(const void* p) {
+    return arena && arena->owns(p);
+}
+
+bool from_bootstrap(const void* p) {
+    return p >= bootstrap_heap && p < bootstrap_heap + sizeof(bootstrap_heap);
+}
+
+void* bootstrap_alloc(size_t n) {
+    n = (n + 15) & ~(size_t)15;
+    if (bootstrap_used + n > sizeof(bootstrap_heap))
+        return nullptr;
+    void* p = bootstrap_heap + bootstrap_used;
+    bootstrap_used += n;
+    return p;
+}
+
+__attribute__((constructor)) void init_early() {
+    ensure_init();
+}
+
+// To stderr: the program's stdout may be a pipe its parent is parsing
+__attribute__((destructor)) void report() {
+    if (!print_stats || !arena)
+        return;
+    with_arena([](Arena& a) {
+        const MemoryManager& heap = a.heap();
+        fprintf(stderr,
+                "memsim arena: %zu requests, %zu failed, %zu fell back to system malloc\n"
+                "memsim arena: %zu bytes used, %zu free, largest free %zu, "
+                "internal fragmentation %zu bytes, external %.2f%%\n",
+                heap.get_total_requests(), heap.get_failed_allocs(), fallbacks,
+                heap.get_used_memory(), heap.get_free_memory(), heap.get_largest_free(),
+                a.internal_fragmentation(), heap.external_fragmentation());
+    });
+}
+
+} // namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+    ensure_init();
+    if (!real_malloc)
+        return bootstrap_alloc(size);
+
+    void* p = arena_alloc(size, Arena::MIN_ALIGN);
+    return p ? p : real_malloc(size);
+}
+
+void free(void* ptr) {
+    if (!ptr || from_bootstrap(ptr))
+        return;
+    ensure_init();
+
+    if (!in_region(ptr)) {
+        real_free(ptr);
+        return;
+    }
+    with_arena([&](Arena& a) { a.free(ptr); });
+}
+
+void* calloc(size_t nmemb, size_t size) {
+    ensure_init();
+    if (!real_calloc)
+        return bootstrap_alloc(nmemb * size);   // zeroed static storage
+
+    if (size && nmemb > (size_t)-1 / size) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    // Arena blocks are reused, so unlike fresh pages they need clearing
+    void* p = arena_alloc(nmemb * size, Arena::MIN_ALIGN);
+    if (!p)
+        return real_calloc(nmemb, size);
+    memset(p, 0, nmemb * size);
+    return p;
+}
+
+void* realloc(void* ptr, size_t size) {
+    ensure_init();
+    if (!ptr)
+        return malloc(size);
+    if (from_bootstrap(ptr)) {
+        void* p = malloc(size);
+        if (p) {
+            size_t avail = bootstrap_heap + sizeof(bootstrap_heap) - (char*)ptr;
+            memcpy(p, ptr, size < avail ? size : avail);
+        }
+        return p;
+    }
+    if (!in_region(ptr))
+        return real_realloc(ptr, size);
+
+    void* p = nullptr;
+    size_t old_size = 0;
+    with_arena([&](Arena& a) {
+        old_size = a.usable_size(ptr);
+        p = a.realloc(ptr, size);
+    });
+    if (p || size == 0)
+        return p;
+
+    // No room in the arena: move the block out to the system heap
+    p = real_malloc(size);
+    if (p) {
+        memcpy(p, ptr, old_size < size ? old_size : size);
+        with_arena([&](Arena& a) {
+            a.free(ptr);
+            fallbacks++;
+        });
+    }
+    return p;
+}
+
+int posix_memalign(void** memptr, size_t alignment, size_t size) {
+    ensure_init();
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    void* p = arena_alloc(size, alignment);
+    if (!p)
+        return real_posix_memalign(memptr, alignment, size);
+    *memptr = p;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    void* p = nullptr;
+    int rc = posix_memalign(&p, alignment, size);
+    if (rc != 0)
+        errno = rc;
+    return p;
+}
+
+void* memalign(size_t alignment, size_t size) {
+    return aligned_alloc(alignment, size);
+}
+
+size_t malloc_usable_size(void* ptr) {
+    if (!ptr || from_bootstrap(ptr))
+        return 0;
+    ensure_init();
+    if (!in_region(ptr))
+        return real_usable_size(ptr);
+
+    size_t size = 0;
+    with_arena([&](Arena& a) { size = a.usable_size(ptr); });
+    return size;
+}
+
+}
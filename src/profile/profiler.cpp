@@ -0,0 +1,84 @@
+#include "profiler.h"
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+void LatencyHistogram::reset() {
+    *this = LatencyHistogram();
+}
+
+uint64_t LatencyHistogram::bucket_limit(int bucket) {
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t sub = bucket % SUB_BUCKETS + SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(p / 100.0 * total + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= rank)
+            return bucket_limit(b) < max_value ? bucket_limit(b) : max_value;
+    }
+    return max_value;
+}
+
+uint64_t Profiler::now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+const char* Profiler::tick_unit() {
+#if defined(__x86_64__) || defined(__i386__)
+    return "TSC ticks";
+#else
+    return "ns";
+#endif
+}
+
+void Profiler::print(std::ostream& out) {
+    static const char* probe_names[] = {
+        "malloc", "free", "buddy split", "buddy coalesce",
+        "cache access", "tlb lookup", "page fault"
+    };
+    static const char* counter_names[] = {
+        "list nodes visited", "buddy splits", "buddy merges", "cache lines scanned"
+    };
+
+    out << "Latency (" << tick_unit() << "): count / min / avg / p50 / p90 / p99 / p99.9 / max\n";
+    for (int i = 0; i < (int)Probe::COUNT; i++) {
+        const LatencyHistogram& h = histograms[i];
+        if (h.count() == 0)
+            continue;
+        out << "  " << probe_names[i] << ": " << h.count()
+            << " / " << h.min() << " / " << (uint64_t)h.mean()
+            << " / " << h.percentile(50) << " / " << h.percentile(90)
+            << " / " << h.percentile(99) << " / " << h.percentile(99.9)
+            << " / " << h.max() << "\n";
+    }
+
+    for (int i = 0; i < (int)ProfileCounter::COUNT; i++)
+        out << counter_names[i] << ": " << counters[i] << "\n";
+}
+
+void Profiler::reset() {
+    for (LatencyHistogram& h : histograms)
+        h.reset();
+    for (uint64_t& c : counters)
+        c = 0;
+}
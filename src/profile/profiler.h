@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Hot-path instrumentation. Everything here is compiled out unless the
+// build defines MEMSIM_PROFILE (MEMSIM_PROFILE=1 ./setup.sh); the probe
+// macros then expand to nothing.
+
+enum class Probe {
+    MALLOC,
+    FREE,
+    BUDDY_SPLIT,
+    BUDDY_COALESCE,
+    CACHE_ACCESS,
+    TLB_LOOKUP,
+    PAGE_FAULT,
+    COUNT
+};
+
+enum class ProfileCounter {
+    LIST_NODES_VISITED,     // MemoryManager block list walks
+    BUDDY_SPLITS,
+    BUDDY_MERGES,
+    CACHE_LINES_SCANNED,
+    COUNT
+};
+
+// Log-linear histogram in the style of HdrHistogram: each power of two
+// is split into SUB_BUCKETS linear buckets, so any recorded value is
+// reported within 1/SUB_BUCKETS of its true value.
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    void record(uint64_t value) {
+        counts[bucket_of(value)]++;
+        total++;
+        sum += value;
+        if (value < min_value)
+            min_value = value;
+        if (value > max_value)
+            max_value = value;
+    }
+
+    void reset();
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? min_value : 0; }
+    uint64_t max() const { return max_value; }
+    double mean() const { return total ? (double)sum / total : 0.0; }
+    // Upper bound of the bucket holding the given percentile (0-100)
+    uint64_t percentile(double p) const;
+
+private:
+    uint64_t counts[BUCKETS] = {};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t min_value = UINT64_MAX;
+    uint64_t max_value = 0;
+
+    // Values below SUB_BUCKETS map linearly; above that the exponent
+    // picks the group and the next SUB_BITS bits pick the bucket
+    static int bucket_of(uint64_t value) {
+        if (value < SUB_BUCKETS)
+            return (int)value;
+        int exponent = 63 - __builtin_clzll(value);
+        int shift = exponent - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + (int)((value >> shift) - SUB_BUCKETS);
+    }
+    static uint64_t bucket_limit(int bucket);
+};
+
+class Profiler {
+public:
+    static LatencyHistogram& histogram(Probe probe) {
+        return histograms[(int)probe];
+    }
+    static void count(ProfileCounter counter, uint64_t n) {
+        counters[(int)counter] += n;
+    }
+
+    // Timestamp in clock ticks: TSC cycles on x86, nanoseconds elsewhere
+    static uint64_t now();
+    static const char* tick_unit();
+
+    static void print(std::ostream& out);
+    static void reset();
+
+private:
+    static inline LatencyHistogram histograms[(int)Probe::COUNT];
+    static inline uint64_t counters[(int)ProfileCounter::COUNT] = {};
+};
+
+// Times the enclosing scope into a probe's histogram
+class ProbeTimer {
+public:
+    explicit ProbeTimer(Probe probe) : probe(probe), start(Profiler::now()) {}
+    ~ProbeTimer() { Profiler::histogram(probe).record(Profiler::now() - start); }
+
+private:
+    Probe probe;
+    uint64_t start;
+};
+
+#ifdef MEMSIM_PROFILE
+#define MEMSIM_PROFILE_CONCAT2(a, b) a##b
+#define MEMSIM_PROFILE_CONCAT(a, b) MEMSIM_PROFILE_CONCAT2(a, b)
+#define MEMSIM_PROBE(probe) \
+    ProbeTimer MEMSIM_PROFILE_CONCAT(probe_timer_, __LINE__)(Probe::probe)
+#define MEMSIM_COUNT(counter, n) Profiler::count(ProfileCounter::counter, (n))
+#else
+#define MEMSIM_PROBE(probe) do {} while (0)
+#define MEMSIM_COUNT(counter, n) do {} while (0)
+#endif
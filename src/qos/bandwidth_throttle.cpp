@@ -0,0 +1,97 @@
+#include "bandwidth_throttle.h"
+#include <algorithm>
+#include <iterator>
+
+void BandwidthThrottle::configure(double rate) {
+    bytes_per_cycle = std::max(rate, 0.0);
+    // Tenants start together on an idle link
+    link.clear();
+    for (auto& [id, tenant] : tenants) {
+        tenant.clock = 0;
+        tenant.busy_until = 0;
+    }
+}
+
+bool BandwidthThrottle::set_limit(int tenant, unsigned percent) {
+    if (percent == 0 || percent > 100)
+        return false;
+    tenants[tenant].percent = percent;
+    return true;
+}
+
+void BandwidthThrottle::reset() {
+    bytes_per_cycle = 0;
+    tenants.clear();
+    link.clear();
+}
+
+// Start of the first gap of at least duration from earliest on, which
+// is then marked busy
+double BandwidthThrottle::occupy_link(double earliest, double duration) {
+    double start = earliest;
+    auto next = link.upper_bound(start);
+    if (next != link.begin() && std::prev(next)->second > start)
+        start = std::prev(next)->second;
+    while (next != link.end() && next->first < start + duration) {
+        start = std::max(start, next->second);
+        ++next;
+    }
+
+    double end = start + duration;
+    double begin = start;
+    next = link.lower_bound(start);
+    if (next != link.begin() && std::prev(next)->second >= start) {
+        begin = std::prev(next)->first;
+        link.erase(std::prev(next));
+    }
+    while (next != link.end() && next->first <= end) {
+        end = std::max(end, next->second);
+        next = link.erase(next);
+    }
+    link[begin] = end;
+
+    if (link.size() > LINK_HISTORY)
+        link.erase(link.begin());
+    return start;
+}
+
+uint64_t BandwidthThrottle::request(int id, size_t bytes) {
+    if (bytes_per_cycle <= 0)
+        return 0;
+
+    TenantBandwidth& tenant = tenants[id];
+    double now = (double)tenant.clock;
+    double allowed = std::max(now, tenant.busy_until);
+    double start = occupy_link(allowed, bytes / bytes_per_cycle);
+    tenant.busy_until = start + bytes / (bytes_per_cycle * tenant.percent / 100.0);
+
+    uint64_t stall = (uint64_t)(start - now);
+    tenant.transfers++;
+    tenant.bytes += bytes;
+    // At 100% the share is the whole link: waiting for it is not throttling
+    if (allowed > now && tenant.percent < 100)
+        tenant.throttled++;
+    if (start > allowed)
+        tenant.contended++;
+    tenant.stall_cycles += stall;
+    return stall;
+}
+
+void BandwidthThrottle::advance(int id, uint64_t cycles) {
+    if (bytes_per_cycle > 0)
+        tenants[id].clock += cycles;
+}
+
+void BandwidthThrottle::print_stats(std::ostream& out) const {
+    if (!is_enabled()) {
+        out << "Memory bandwidth: unlimited\n";
+        return;
+    }
+    out << "Memory bandwidth: " << bytes_per_cycle << " bytes/cycle\n";
+    for (const auto& [id, tenant] : tenants) {
+        out << "Tenant " << id << ": " << tenant.percent << "% limit, "
+            << tenant.transfers << " transfers, " << tenant.bytes << " bytes, "
+            << tenant.throttled << " throttled, " << tenant.contended << " contended, "
+            << tenant.stall_cycles << " stall cycles\n";
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+
+// Memory bandwidth allocation in the style of Intel MBA. One link moves
+// bytes_per_cycle for all tenants; a tenant limited to p percent may
+// also use no more than p percent of it. A transfer waits until the
+// tenant's share is free, then for a gap on the link.
+//
+// Co-located tenants run side by side, so each has its own clock,
+// advanced by the cycles of its accesses, and the link remembers when
+// it is busy on that shared time axis. Off (0 bytes per cycle) by
+// default.
+class BandwidthThrottle {
+public:
+    void configure(double bytes_per_cycle);
+    bool is_enabled() const { return bytes_per_cycle > 0; }
+    // percent in 1..100; false otherwise
+    bool set_limit(int tenant, unsigned percent);
+    void reset();
+
+    // Stall cycles for tenant moving bytes at its current clock
+    uint64_t request(int tenant, size_t bytes);
+    // The tenant spent cycles on an access
+    void advance(int tenant, uint64_t cycles);
+
+    void print_stats(std::ostream& out) const;
+
+private:
+    struct TenantBandwidth {
+        unsigned percent = 100;
+        uint64_t clock = 0;
+        double busy_until = 0;      // cycle at which the tenant's share frees up
+        uint64_t transfers = 0;
+        uint64_t bytes = 0;
+        uint64_t throttled = 0;     // transfers that waited for their share
+        uint64_t contended = 0;     // transfers that found the link busy
+        uint64_t stall_cycles = 0;
+    };
+
+    // Busy periods kept; a tenant further behind finds the link free
+    static const size_t LINK_HISTORY = 4096;
+
+    double bytes_per_cycle = 0;
+    std::map<int, TenantBandwidth> tenants;
+    // Busy periods of the link, start -> end, disjoint and not touching
+    std::map<double, double> link;
+
+    double occupy_link(double earliest, double duration);
+};
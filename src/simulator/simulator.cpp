@@ -0,0 +1,1006 @@
+#include "simulator.h"
+#include "../io/output.h"
+#include "../profile/profiler.h"
+#include "../trace/trace_reader.h"
+#include "../trace/alloc_import.h"
+#include "../checkpoint/checkpoint.h"
+#include <chrono>
+#include <vector>
+
+Simulator::Simulator()
+    : l1(128, 16, 1),   // 1 cycle per access
+      l2(512, 16, 5),   // 5 cycles per access
+      vm(4)             // 4 physical frames
+{
+    register_stats();
+}
+
+static double share(double part, double whole) {
+    return whole > 0 ? part / whole : 0.0;
+}
+
+void Simulator::register_stats() {
+    series.add("mem.used", [this] { return mem.get_used_memory(); });
+    series.add("mem.free", [this] { return mem.get_free_memory(); });
+    series.add("mem.largest_free", [this] { return mem.get_largest_free(); });
+    series.add("mem.internal_frag", [this] { return mem.get_internal_fragmentation(); });
+    series.add("mem.external_frag_pct", [this] { return mem.external_fragmentation(); });
+    series.add("mem.blocks", [this] { return mem.get_block_count(); });
+    series.add("mem.requests", [this] { return mem.get_total_requests(); });
+    series.add("mem.failed", [this] { return mem.get_failed_allocs(); });
+    series.add("mem.compact_bytes", [this] { return mem.get_compaction_stats().bytes_moved; });
+    series.add("mem.compact_pause", [this] { return mem.get_compaction_stats().total_pause; });
+
+    series.add("l1.hits", [this] { return l1.get_hits(); });
+    series.add("l1.misses", [this] { return l1.get_misses(); });
+    series.add("l1.hit_rate", [this] {
+        return share(l1.get_hits(), l1.get_hits() + l1.get_misses());
+    });
+    series.add("l2.hits", [this] { return l2.get_hits(); });
+    series.add("l2.misses", [this] { return l2.get_misses(); });
+    series.add("l2.hit_rate", [this] {
+        return share(l2.get_hits(), l2.get_hits() + l2.get_misses());
+    });
+
+    series.add("tlb.hits", [this] { return vm.get_tlb().get_hits(); });
+    series.add("tlb.misses", [this] { return vm.get_tlb().get_misses(); });
+    series.add("vm.page_hits", [this] { return vm.get_page_hits(); });
+    series.add("vm.page_faults", [this] { return vm.get_page_faults(); });
+    series.add("vm.fault_rate", [this] {
+        return share(vm.get_page_faults(), vm.get_page_hits() + vm.get_page_faults());
+    });
+}
+
+bool Simulator::execute(std::string_view line) {
+    Tokenizer tok(line);
+    std::string_view cmd = tok.next();
+
+    if (cmd == "init")          cmd_init(tok);
+    else if (cmd == "dump")     cmd_dump(tok);
+    else if (cmd == "exit")     return false;
+    else if (cmd == "malloc")   cmd_malloc(tok);
+    else if (cmd == "free")     cmd_free(tok);
+    else if (cmd == "realloc")  cmd_realloc(tok);
+    else if (cmd == "malloc_aligned") cmd_malloc_aligned(tok);
+    else if (cmd == "compact")  cmd_compact(tok);
+    else if (cmd == "buddy")    cmd_buddy(tok);
+    else if (cmd == "attribution") cmd_attribution(tok);
+    else if (cmd == "qos")      cmd_qos(tok);
+    else if (cmd == "stats")    cmd_stats(tok);
+    else if (cmd == "set")      cmd_set(tok);
+    else if (cmd == "access")   cmd_access(tok, false);
+    else if (cmd == "write")    cmd_access(tok, true);
+    else if (cmd == "cache")    cmd_cache(tok);
+    else if (cmd == "vm")       cmd_vm(tok);
+    else if (cmd == "tlb")      cmd_tlb(tok);
+    else if (cmd == "trace")    cmd_trace(tok);
+    else if (cmd == "profile")  cmd_profile(tok);
+    else if (cmd == "workload") cmd_workload(tok);
+    else if (cmd == "checkpoint") cmd_checkpoint(tok);
+    else
+        MEMSIM_SUMMARY("Unknown command\n");
+
+    return true;
+}
+
+int Simulator::access(size_t virtual_addr, bool write) {
+    int total_latency = 0;
+    int tlb_misses = vm.get_tlb().get_misses();
+    int page_faults = vm.get_page_faults();
+    bool l1_miss = false, l2_miss = false;
+
+    //  Virtual Memory
+    int physical_addr = vm.access(virtual_addr, write);
+    total_latency += 1; // assume 1 cycle for page table/TLB access
+    total_latency += vm.take_stall_cycles();
+
+    //  L1 Cache
+    if (l1.access(physical_addr)) {
+        MEMSIM_TRACE("L1 HIT\n");
+        total_latency += l1.get_latency();
+    } else {
+        MEMSIM_TRACE("L1 MISS -> ");
+        total_latency += l1.get_latency();
+        l1_miss = true;
+
+        //  L2 Cache
+        if (l2.access(physical_addr)) {
+            MEMSIM_TRACE("L2 HIT\n");
+            total_latency += l2.get_latency();
+        } else {
+            MEMSIM_TRACE("L2 MISS -> Memory Access\n");
+            total_latency += l2.get_latency() + vm.memory_latency(physical_addr);
+            total_latency += bandwidth.request(tenant, l2.get_block_size());
+            l2_miss = true;
+        }
+    }
+    MEMSIM_TRACE("Total access latency: " << total_latency << " cycles\n");
+    if (bandwidth.is_enabled())
+        bandwidth.advance(tenant, total_latency);
+
+    if (attribution.is_enabled()) {
+        int block = mem.block_at(virtual_addr);
+        attribution.record(block, block == -1 ? 0 : mem.block_size(block), l1_miss, l2_miss,
+                           vm.get_tlb().get_misses() != tlb_misses,
+                           vm.get_page_faults() != page_faults);
+    }
+    tick(total_latency);
+    return total_latency;
+}
+
+int Simulator::do_malloc(size_t size) {
+    int id = mem.malloc_block(size);
+    tick(0);
+    if (recorder.is_open()) {
+        if (id != -1)
+            recorded_ids[id] = recorder.allocations();
+        recorder.append(TraceOp::ALLOC, size);
+    }
+    return id;
+}
+
+bool Simulator::do_free(int id) {
+    if (recorder.is_open()) {
+        auto it = recorded_ids.find(id);
+        if (it != recorded_ids.end()) {
+            recorder.append(TraceOp::FREE, it->second);
+            recorded_ids.erase(it);
+        }
+    }
+
+    bool freed = mem.free_block(id);
+    if (freed)
+        attribution.retire(id);
+    tick(0);
+    return freed;
+}
+
+void Simulator::do_access(size_t virtual_addr, bool write) {
+    if (recorder.is_open())
+        recorder.append(write ? TraceOp::WRITE : TraceOp::ACCESS, virtual_addr);
+    access(virtual_addr, write);
+}
+
+void Simulator::cmd_init(Tokenizer& tok) {
+    std::string_view type = tok.next();
+    size_t size;
+    tok.next_number(size);
+
+    if (type == "memory") {
+        mem.init_memory(size);
+        attribution.reset();
+        MEMSIM_SUMMARY("Initialized memory with size " << size << " bytes\n");
+    }
+}
+
+void Simulator::cmd_dump(Tokenizer& tok) {
+    std::string_view what = tok.next();
+    std::string_view level = tok.next();
+
+    if (what == "memory") {
+        mem.dump_memory();
+    }
+    if (what == "cache") {
+        if (level == "l1") l1.dump();
+        else if (level == "l2") l2.dump();
+    }
+    if (what == "vm") {
+        vm.dump();
+    }
+}
+
+void Simulator::cmd_malloc(Tokenizer& tok) {
+    size_t size;
+    tok.next_number(size);
+
+    int id = do_malloc(size);
+    if (id == -1) {
+        MEMSIM_SUMMARY("Allocation failed\n");
+    } else {
+        MEMSIM_SUMMARY("Allocated block id=" << id << "\n");
+    }
+}
+
+void Simulator::cmd_malloc_aligned(Tokenizer& tok) {
+    size_t size, align;
+    tok.next_number(size);
+    tok.next_number(align);
+
+    if (align == 0 || (align & (align - 1)) != 0) {
+        MEMSIM_SUMMARY("Alignment must be a power of two\n");
+        return;
+    }
+
+    int id = mem.malloc_aligned(size, align);
+    tick(0);
+    if (recorder.is_open()) {
+        if (id != -1)
+            recorded_ids[id] = recorder.allocations();
+        recorder.append(TraceOp::ALIGNED_ALLOC, size, align);
+    }
+
+    if (id == -1) {
+        MEMSIM_SUMMARY("Allocation failed\n");
+    } else {
+        MEMSIM_SUMMARY("Allocated block id=" << id << " aligned to " << align << "\n");
+    }
+}
+
+void Simulator::cmd_realloc(Tokenizer& tok) {
+    int id = 0;
+    size_t size = 0;
+    // A missing size must not turn into realloc(p, 0)
+    if (!tok.next_number(id) || !tok.next_number(size)) {
+        MEMSIM_SUMMARY("Usage: realloc <id> <size>\n");
+        return;
+    }
+
+    // realloc(p, 0) frees, as in C
+    int new_id = -1;
+    bool done = size == 0 ? mem.free_block(id)
+                          : (new_id = mem.realloc_block(id, size)) != -1;
+    tick(0);
+    if (done)
+        attribute_realloc(id, new_id, size);
+
+    if (done && recorder.is_open()) {
+        auto it = recorded_ids.find(id);
+        if (it != recorded_ids.end()) {
+            uint64_t index = it->second;
+            recorder.append(TraceOp::REALLOC, index, size);
+            // Buddy ids are addresses and change when the block moves
+            if (new_id != id) {
+                recorded_ids.erase(it);
+                if (new_id != -1)
+                    recorded_ids[new_id] = index;
+            }
+        }
+    }
+
+    if (size == 0) {
+        if (done)
+            MEMSIM_SUMMARY("Block " << id << " freed\n");
+        else
+            MEMSIM_SUMMARY("Invalid block id\n");
+    } else if (!done) {
+        MEMSIM_SUMMARY("Reallocation failed\n");
+    } else {
+        MEMSIM_SUMMARY("Block " << id << " resized to " << size
+                       << " bytes, id=" << new_id << "\n");
+    }
+}
+
+void Simulator::cmd_free(Tokenizer& tok) {
+    int id;
+    tok.next_number(id);
+
+    if (do_free(id)) {
+        MEMSIM_SUMMARY("Block " << id << " freed and merged\n");
+    } else {
+        MEMSIM_SUMMARY("Invalid block id\n");
+    }
+}
+
+void Simulator::cmd_compact(Tokenizer& tok) {
+    std::string_view what = tok.next();
+
+    if (what == "on_failure") {
+        bool enabled = tok.next() == "on";
+        mem.set_compact_on_failure(enabled);
+        MEMSIM_SUMMARY("Compact on allocation failure " << (enabled ? "on" : "off") << "\n");
+        return;
+    }
+    if (what == "threshold") {
+        // compact threshold <percent> [budget bytes]
+        double threshold = 0;
+        size_t budget = 0;
+        tok.next_number(threshold);
+        tok.next_number(budget);
+        mem.set_compaction_threshold(threshold, budget);
+        MEMSIM_SUMMARY("Compact at " << threshold << "% external fragmentation"
+                       << (budget ? ", budget " + std::to_string(budget) + " bytes" : "")
+                       << "\n");
+        return;
+    }
+    if (what == "stats" || what == "history") {
+        const CompactionStats& stats = mem.get_compaction_stats();
+        if (!stats.used())
+            Output::stream() << "No compactions\n";
+        else if (what == "stats")
+            stats.print(Output::stream());
+        else
+            mem.print_compaction_history();
+        return;
+    }
+
+    if (mem.get_allocator() == AllocatorType::BUDDY) {
+        MEMSIM_SUMMARY("Compaction is not supported by the buddy allocator\n");
+        return;
+    }
+
+    // compact | compact step <budget bytes>
+    size_t moved;
+    if (what == "step") {
+        size_t budget = 0;
+        tok.next_number(budget);
+        moved = mem.compact_step(budget);
+    } else {
+        moved = mem.compact();
+    }
+
+    for (const auto& [id, start] : mem.relocation_map())
+        MEMSIM_TRACE("Block " << id << " -> 0x" << std::hex << start << std::dec << "\n");
+
+    const CompactionEvent& last = mem.get_compaction_stats().last;
+    MEMSIM_SUMMARY("Compacted: " << last.blocks_moved << " blocks, " << moved
+                   << " bytes moved, " << last.pause_cycles << " cycles\n");
+}
+
+void Simulator::cmd_buddy(Tokenizer& tok) {
+    std::string_view what = tok.next();
+    BuddyAllocator& buddy = mem.get_buddy();
+    BuddyConfig config = buddy.get_config();
+
+    if (what == "stats") {
+        buddy.print_buddy_stats();
+        return;
+    }
+    if (what == "dump") {
+        buddy.dump();
+        return;
+    }
+    if (what == "drain") {
+        buddy.drain();
+        MEMSIM_SUMMARY("Per-CPU lists drained and free blocks coalesced\n");
+        return;
+    }
+    if (what == "cpu") {
+        size_t cpu = 0;
+        tok.next_number(cpu);
+        buddy.set_cpu(cpu);
+        MEMSIM_SUMMARY("Running on CPU " << cpu << "\n");
+        return;
+    }
+    if (what == "type") {
+        std::string_view which = tok.next();
+        if (which == "unmovable")
+            buddy.set_migrate_type(MigrateType::UNMOVABLE);
+        else if (which == "reclaimable")
+            buddy.set_migrate_type(MigrateType::RECLAIMABLE);
+        else
+            buddy.set_migrate_type(MigrateType::MOVABLE);
+        MEMSIM_SUMMARY("Migrate type set to " << which << "\n");
+        return;
+    }
+
+    // buddy pcp <cpus> [batch] [high] [max_order] | buddy pcp off
+    if (what == "pcp") {
+        std::string_view arg = tok.next();
+        config.pcp_cpus = 0;
+        if (arg != "off") {
+            Tokenizer::parse_number(arg, config.pcp_cpus);
+            // Trailing settings are optional and keep their values
+            size_t value;
+            for (size_t* setting : {&config.pcp_batch, &config.pcp_high, &config.pcp_max_order}) {
+                if (!tok.next_number(value))
+                    break;
+                *setting = value;
+            }
+        }
+        buddy.configure(config);
+        config = buddy.get_config();
+        if (config.pcp_cpus)
+            MEMSIM_SUMMARY("Per-CPU lists: " << config.pcp_cpus << " CPUs, batch "
+                           << config.pcp_batch << ", high " << config.pcp_high
+                           << ", orders 0-" << config.pcp_max_order << "\n");
+        else
+            MEMSIM_SUMMARY("Per-CPU lists off\n");
+    }
+    // buddy lazy <watermark> | buddy lazy off
+    else if (what == "lazy") {
+        std::string_view arg = tok.next();
+        config.lazy_merge = arg != "off";
+        if (config.lazy_merge)
+            Tokenizer::parse_number(arg, config.merge_watermark);
+        buddy.configure(config);
+        if (config.lazy_merge)
+            MEMSIM_SUMMARY("Lazy coalescing, watermark " << config.merge_watermark << " frees\n");
+        else
+            MEMSIM_SUMMARY("Eager coalescing\n");
+    }
+    // buddy group <pageblock bytes> | buddy group off
+    else if (what == "group") {
+        std::string_view arg = tok.next();
+        config.pageblock_size = 0;
+        if (arg != "off")
+            Tokenizer::parse_number(arg, config.pageblock_size);
+        buddy.configure(config);
+        if (buddy.get_config().pageblock_size)
+            MEMSIM_SUMMARY("Migrate-type grouping, pageblock "
+                           << buddy.get_config().pageblock_size << " bytes\n");
+        else
+            MEMSIM_SUMMARY("Migrate-type grouping off\n");
+    }
+}
+
+void Simulator::attribute_realloc(int old_id, int new_id, size_t size) {
+    if (size == 0)
+        attribution.retire(old_id);
+    else if (new_id != -1)
+        attribution.rename(old_id, new_id);
+}
+
+void Simulator::cmd_attribution(Tokenizer& tok) {
+    std::string_view what = tok.next();
+
+    if (what == "on" || what == "off") {
+        attribution.set_enabled(what == "on");
+        MEMSIM_SUMMARY("Miss attribution " << what << "\n");
+    }
+    else if (what == "reset") {
+        attribution.reset();
+        MEMSIM_SUMMARY("Miss attribution reset\n");
+    }
+    // attribution top [n] [l1|l2|tlb|faults|all]
+    else if (what == "top") {
+        size_t n = 10;
+        std::string_view arg = tok.next();
+        if (Tokenizer::parse_number(arg, n))
+            arg = tok.next();
+        else
+            n = 10;
+
+        MissKind kind = MissKind::ALL;
+        if (arg == "l1")          kind = MissKind::L1;
+        else if (arg == "l2")     kind = MissKind::L2;
+        else if (arg == "tlb")    kind = MissKind::TLB;
+        else if (arg == "faults") kind = MissKind::PAGE_FAULT;
+        attribution.print_top(Output::stream(), n, kind);
+    }
+}
+
+void Simulator::switch_tenant(int id) {
+    tenant = id;
+    l1.set_tenant(id);
+    l2.set_tenant(id);
+}
+
+// Decimal, or hex with a 0x prefix as CAT masks are usually written
+static bool parse_mask(std::string_view token, uint64_t& mask) {
+    if (token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X')) {
+        auto [ptr, ec] = std::from_chars(token.data() + 2, token.data() + token.size(), mask, 16);
+        return ec == std::errc() && ptr == token.data() + token.size();
+    }
+    return Tokenizer::parse_number(token, mask);
+}
+
+void Simulator::cmd_qos(Tokenizer& tok) {
+    std::string_view what = tok.next();
+
+    if (what == "tenant") {
+        int id = 0;
+        tok.next_number(id);
+        switch_tenant(id);
+        if (recorder.is_open())
+            recorder.append(TraceOp::TENANT, id);
+        MEMSIM_SUMMARY("Tenant " << id << "\n");
+    }
+    // qos clos <clos> <mask>: the L2 ways the class may fill
+    else if (what == "clos") {
+        size_t clos = 0;
+        uint64_t mask = 0;
+        tok.next_number(clos);
+        if (parse_mask(tok.next(), mask) && l2.set_clos_mask(clos, mask))
+            MEMSIM_SUMMARY("CLOS " << clos << " fills L2 ways 0x" << std::hex << mask
+                           << std::dec << " of " << l2.mask_bits() << "\n");
+        else
+            MEMSIM_SUMMARY("Invalid CLOS or mask (" << Cache::MAX_CLOS << " classes, "
+                           << l2.mask_bits() << " ways)\n");
+    }
+    // qos assoc <tenant> <clos>
+    else if (what == "assoc") {
+        int id = 0;
+        size_t clos = 0;
+        tok.next_number(id);
+        tok.next_number(clos);
+        if (l2.assign_clos(id, clos))
+            MEMSIM_SUMMARY("Tenant " << id << " uses CLOS " << clos << "\n");
+        else
+            MEMSIM_SUMMARY("Invalid CLOS " << clos << "\n");
+    }
+    // qos bandwidth <bytes per cycle>, 0 for unlimited
+    else if (what == "bandwidth") {
+        double rate = 0;
+        tok.next_number(rate);
+        bandwidth.configure(rate);
+        MEMSIM_SUMMARY("Memory bandwidth " << rate << " bytes/cycle\n");
+    }
+    // qos throttle <tenant> <percent>
+    else if (what == "throttle") {
+        int id = 0;
+        unsigned percent = 0;
+        tok.next_number(id);
+        tok.next_number(percent);
+        if (bandwidth.set_limit(id, percent))
+            MEMSIM_SUMMARY("Tenant " << id << " limited to " << percent << "% of memory bandwidth\n");
+        else
+            MEMSIM_SUMMARY("Throttle must be 1-100%\n");
+    }
+    else if (what == "stats") {
+        std::ostream& out = Output::stream();
+        out << "L1 tenants\n";
+        l1.print_tenant_stats();
+        out << "L2 tenants\n";
+        l2.print_tenant_stats();
+        bandwidth.print_stats(out);
+    }
+    else if (what == "reset") {
+        tenant = 0;
+        l1.reset_partitions();
+        l2.reset_partitions();
+        bandwidth.reset();
+        MEMSIM_SUMMARY("Partitions and bandwidth limits removed\n");
+    }
+}
+
+void Simulator::cmd_stats(Tokenizer& tok) {
+    std::string_view what = tok.next();
+    std::ostream& out = Output::stream();
+
+    if (what == "all") {
+        out << "\n===== MEMORY STATS =====\n";
+        mem.print_stats();
+
+        out << "\n===== L1 CACHE STATS =====\n";
+        l1.print_stats();
+
+        out << "\n===== L2 CACHE STATS =====\n";
+        l2.print_stats();
+
+        out << "\n===== VIRTUAL MEMORY STATS =====\n";
+        vm.print_stats();
+    }
+    else if (what == "record") {
+        // stats record <file.jsonl|file.csv> <interval> [ops|cycles]
+        std::string path(tok.next());
+        uint64_t interval = 0;
+        tok.next_number(interval);
+        bool by_cycles = tok.next() == "cycles";
+
+        bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+        if (!series.open(path, csv ? StatsFormat::CSV : StatsFormat::JSON_LINES,
+                         interval, by_cycles)) {
+            MEMSIM_SUMMARY("Cannot open stats file " << path << "\n");
+            return;
+        }
+        MEMSIM_SUMMARY("Sampling stats to " << path << " every " << interval
+                       << (by_cycles ? " cycles\n" : " operations\n"));
+    }
+    else if (what == "stop") {
+        if (!series.is_open())
+            return;
+        series.close();
+        MEMSIM_SUMMARY("Stats series closed: " << series.samples_written() << " samples\n");
+    }
+}
+
+void Simulator::cmd_set(Tokenizer& tok) {
+    std::string_view what = tok.next();
+    std::string_view which = tok.next();
+
+    if (what == "allocator") {
+        if (which == "first_fit")
+            mem.set_allocator(AllocatorType::FIRST_FIT);
+        else if (which == "best_fit")
+            mem.set_allocator(AllocatorType::BEST_FIT);
+        else if (which == "worst_fit")
+            mem.set_allocator(AllocatorType::WORST_FIT);
+        else if (which == "buddy") {
+            mem.set_allocator(AllocatorType::BUDDY);
+        }
+        MEMSIM_SUMMARY("Allocator set to " << which << "\n");
+    }
+    else if (what == "verbosity") {
+        if (which == "quiet")
+            Output::set_verbosity(Verbosity::QUIET);
+        else if (which == "summary")
+            Output::set_verbosity(Verbosity::SUMMARY);
+        else if (which == "trace")
+            Output::set_verbosity(Verbosity::TRACE);
+        MEMSIM_SUMMARY("Verbosity set to " << which << "\n");
+    }
+    else if (what == "engine") {
+        // Compile-time specialized cache/TLB engines, or the generic loops
+        if (which != "specialized" && which != "dynamic") {
+            MEMSIM_SUMMARY("Unknown engine " << which << "\n");
+            return;
+        }
+        bool specialized = which == "specialized";
+        l1.set_specialized(specialized);
+        l2.set_specialized(specialized);
+        vm.set_specialized_tlb(specialized);
+        MEMSIM_SUMMARY("Engine set to " << which << " (L1 "
+                       << (l1.is_specialized() ? "specialized" : "dynamic") << ", L2 "
+                       << (l2.is_specialized() ? "specialized" : "dynamic") << ", TLB "
+                       << (vm.get_tlb().is_specialized() ? "specialized" : "dynamic") << ")\n");
+    }
+}
+
+void Simulator::cmd_access(Tokenizer& tok, bool write) {
+    // Several addresses on one line are independent accesses whose
+    // page faults are issued together, before any of them is served
+    size_t virtual_addr;
+    Tokenizer batch = tok;
+    if (batch.next_number(virtual_addr) && batch.next_number(virtual_addr)) {
+        Tokenizer faults = tok;
+        int budget = vm.fault_batch_limit();
+        while (budget > 0 && faults.next_number(virtual_addr))
+            budget -= vm.prefault(virtual_addr);
+    }
+    while (tok.next_number(virtual_addr))
+        do_access(virtual_addr, write);
+}
+
+void Simulator::cmd_cache(Tokenizer& tok) {
+    std::string_view what = tok.next();
+    std::string_view level = tok.next();
+    std::ostream& out = Output::stream();
+
+    if (what == "stats") {
+        if (level == "l1") {
+            out << "L1 Cache Stats\n";
+            l1.print_stats();
+        }
+        else if (level == "l2") {
+            out << "L2 Cache Stats\n";
+            l2.print_stats();
+        }
+    }
+}
+
+void Simulator::cmd_vm(Tokenizer& tok) {
+    std::string_view what = tok.next();
+
+    if (what == "stats") {
+        vm.print_stats();
+    }
+    else if (what == "tier") {
+        std::string_view arg = tok.next();
+        if (arg == "stats") {
+            vm.print_tier_stats();
+        } else {
+            // vm tier <dram_frames> <slow_frames> <dram_latency>
+            //         <slow_latency> <dram_bw> <slow_bw>
+            // Latency is paid per access; bandwidth only prices migrations
+            MemoryTier dram, slow;
+            Tokenizer::parse_number(arg, dram.frames);
+            tok.next_number(slow.frames);
+            tok.next_number(dram.latency);
+            tok.next_number(slow.latency);
+            tok.next_number(dram.bandwidth);
+            tok.next_number(slow.bandwidth);
+            vm.configure_tiers(dram, slow);
+            MEMSIM_SUMMARY("Tiered memory: " << dram.frames << " DRAM frames, "
+                           << slow.frames << " slow frames\n");
+        }
+    }
+    else if (what == "swap") {
+        std::string_view arg = tok.next();
+        if (arg == "stats") {
+            vm.print_swap_stats();
+        } else {
+            // vm swap <latency> <transfer> <queue_depth>
+            //         <readahead> <writeback_batch>
+            BackingStoreConfig config;
+            Tokenizer::parse_number(arg, config.latency);
+            tok.next_number(config.transfer);
+            tok.next_number(config.queue_depth);
+            tok.next_number(config.readahead);
+            tok.next_number(config.writeback_batch);
+            vm.configure_swap(config);
+            MEMSIM_SUMMARY("Backing store: latency " << config.latency
+                           << ", queue depth " << config.queue_depth
+                           << ", readahead " << config.readahead << " pages\n");
+        }
+    }
+    else if (what == "migrate") {
+        int interval, hot_threshold, max_migrations;
+        tok.next_number(interval);
+        tok.next_number(hot_threshold);
+        tok.next_number(max_migrations);
+        vm.set_migration_policy(interval, hot_threshold, max_migrations);
+        MEMSIM_SUMMARY("Migration every " << interval << " accesses, hot threshold "
+                       << hot_threshold << ", max " << max_migrations << " per epoch\n");
+    }
+}
+
+void Simulator::cmd_tlb(Tokenizer& tok) {
+    std::string_view what = tok.next();
+    if (what == "stats") {
+        vm.print_tlb_stats();
+    }
+}
+
+void Simulator::cmd_trace(Tokenizer& tok) {
+    std::string_view what = tok.next();
+    std::string path(tok.next());
+
+    if (what == "record") {
+        if (!recorder.open(path)) {
+            MEMSIM_SUMMARY("Cannot open trace file " << path << "\n");
+            return;
+        }
+        recorded_ids.clear();
+        attribution.reset();
+        MEMSIM_SUMMARY("Recording trace to " << path << "\n");
+    }
+    else if (what == "stop") {
+        if (!recorder.is_open())
+            return;
+        recorder.close();
+        MEMSIM_SUMMARY("Trace closed: " << recorder.records_written()
+                       << " records, " << recorder.bytes_written() << " bytes\n");
+    }
+    else if (what == "replay") {
+        if (!replay_trace(path))
+            MEMSIM_SUMMARY("Cannot read trace file " << path << "\n");
+    }
+    else if (what == "import") {
+        // trace import <recorder log> <trace file>
+        std::string out_path(tok.next());
+        AllocImportStats stats;
+        if (!import_alloc_log(path, out_path, stats)) {
+            MEMSIM_SUMMARY("Cannot import allocation log " << path << "\n");
+            return;
+        }
+        MEMSIM_SUMMARY("Imported " << stats.events << " events from "
+                       << stats.threads << " threads: "
+                       << stats.allocs << " allocs, " << stats.frees << " frees, "
+                       << stats.reallocs << " reallocs, "
+                       << stats.unmatched_frees << " unmatched frees\n");
+    }
+}
+
+void Simulator::cmd_profile(Tokenizer& tok) {
+#ifdef MEMSIM_PROFILE
+    std::string_view what = tok.next();
+    if (what == "stats") {
+        Profiler::print(Output::stream());
+    }
+    else if (what == "reset") {
+        Profiler::reset();
+        MEMSIM_SUMMARY("Profile counters reset\n");
+    }
+#else
+    (void)tok;
+    MEMSIM_SUMMARY("Profiling is not compiled in (rebuild with MEMSIM_PROFILE=1 ./setup.sh)\n");
+#endif
+}
+
+// Generated operations go through the simulator like typed commands
+class Simulator::LiveSink : public WorkloadSink {
+public:
+    explicit LiveSink(Simulator& sim) : sim(sim) {}
+
+    int alloc(size_t size) override { return sim.do_malloc(size); }
+    void free(int block_id) override { sim.do_free(block_id); }
+    void access(size_t address, bool write) override { sim.do_access(address, write); }
+
+private:
+    Simulator& sim;
+};
+
+// Generated operations are written to a trace instead. A shadow heap with
+// the simulator's allocator and size supplies the block addresses, so the
+// trace replays as generated against the same configuration.
+class TraceSink : public WorkloadSink {
+public:
+    TraceSink(MemoryManager& shadow, TraceWriter& writer)
+        : shadow(shadow), writer(writer) {}
+
+    int alloc(size_t size) override {
+        int id = shadow.malloc_block(size);
+        if (id != -1)
+            indices[id] = writer.allocations();
+        writer.append(TraceOp::ALLOC, size);
+        return id;
+    }
+    void free(int block_id) override {
+        auto it = indices.find(block_id);
+        if (it == indices.end())
+            return;
+        writer.append(TraceOp::FREE, it->second);
+        indices.erase(it);
+        shadow.free_block(block_id);
+    }
+    void access(size_t address, bool write) override {
+        writer.append(write ? TraceOp::WRITE : TraceOp::ACCESS, address);
+    }
+
+private:
+    MemoryManager& shadow;
+    TraceWriter& writer;
+    std::unordered_map<int, uint64_t> indices;  // block id -> allocation index
+};
+
+static void print_workload_stats(const WorkloadStats& stats) {
+    MEMSIM_SUMMARY("Workload: " << stats.ops << " ops, "
+                   << stats.allocs << " allocs (" << stats.failed_allocs << " failed), "
+                   << stats.frees << " frees, " << stats.accesses << " accesses, "
+                   << "peak live " << stats.peak_live << ", "
+                   << stats.bytes_allocated << " bytes allocated\n");
+}
+
+void Simulator::cmd_workload(Tokenizer& tok) {
+    std::string_view what = tok.next();
+
+    if (what == "phase") {
+        // workload phase key=value ...
+        WorkloadPhase phase;
+        for (std::string_view setting = tok.next(); !setting.empty(); setting = tok.next()) {
+            if (!WorkloadGenerator::parse_setting(setting, phase)) {
+                MEMSIM_SUMMARY("Unknown workload setting " << setting << "\n");
+                return;
+            }
+        }
+        workload.phases.push_back(phase);
+        MEMSIM_SUMMARY("Workload phase " << workload.phases.size()
+                       << " added (" << phase.ops << " ops)\n");
+    }
+    else if (what == "clear") {
+        workload.phases.clear();
+        MEMSIM_SUMMARY("Workload phases cleared\n");
+    }
+    else if (what == "run") {
+        // workload run [seed]
+        WorkloadConfig config = workload;
+        uint64_t seed;
+        if (tok.next_number(seed))
+            config.seed = seed;
+
+        LiveSink sink(*this);
+        WorkloadGenerator generator(config);
+        print_workload_stats(generator.run(mem, sink));
+    }
+    else if (what == "trace") {
+        // workload trace <file> [seed]
+        std::string path(tok.next());
+        WorkloadConfig config = workload;
+        uint64_t seed;
+        if (tok.next_number(seed))
+            config.seed = seed;
+
+        TraceWriter writer;
+        if (!writer.open(path)) {
+            MEMSIM_SUMMARY("Cannot open trace file " << path << "\n");
+            return;
+        }
+        MemoryManager shadow;
+        shadow.set_allocator(mem.get_allocator());
+        shadow.init_memory(mem.get_total_memory());
+
+        TraceSink sink(shadow, writer);
+        WorkloadGenerator generator(config);
+        WorkloadStats stats = generator.run(shadow, sink);
+        writer.close();
+
+        print_workload_stats(stats);
+        MEMSIM_SUMMARY("Trace written: " << writer.records_written()
+                       << " records, " << writer.bytes_written() << " bytes\n");
+    }
+}
+
+void Simulator::cmd_checkpoint(Tokenizer& tok) {
+    std::string_view what = tok.next();
+    std::string path(tok.next());
+
+    if (what == "save") {
+        CheckpointWriter writer;
+        mem.save(writer);
+        l1.save(writer, SectionId::L1_STATE, SectionId::L1_LINES);
+        l2.save(writer, SectionId::L2_STATE, SectionId::L2_LINES);
+        vm.save(writer);
+
+        if (!writer.save(path)) {
+            MEMSIM_SUMMARY("Cannot write checkpoint " << path << "\n");
+            return;
+        }
+        MEMSIM_SUMMARY("Checkpoint saved to " << path << ": "
+                       << writer.section_count() << " sections, "
+                       << writer.bytes_written() << " bytes\n");
+    }
+    else if (what == "load") {
+        CheckpointReader reader;
+        if (!reader.open(path)) {
+            MEMSIM_SUMMARY("Cannot read checkpoint " << path << "\n");
+            return;
+        }
+        // Every component is checked before any of them changes, so a bad
+        // file leaves the whole simulator as it was
+        bool ok = mem.can_load(reader) &&
+                  l1.can_load(reader, SectionId::L1_STATE, SectionId::L1_LINES) &&
+                  l2.can_load(reader, SectionId::L2_STATE, SectionId::L2_LINES) &&
+                  vm.can_load(reader);
+        if (!ok) {
+            MEMSIM_SUMMARY("Checkpoint " << path << " is incomplete or corrupt, nothing restored\n");
+            return;
+        }
+        mem.load(reader);
+        l1.load(reader, SectionId::L1_STATE, SectionId::L1_LINES);
+        l2.load(reader, SectionId::L2_STATE, SectionId::L2_LINES);
+        vm.load(reader);
+        recorded_ids.clear();
+        attribution.reset();
+        MEMSIM_SUMMARY("Checkpoint restored from " << path << " ("
+                       << reader.size() << " bytes)\n");
+    }
+}
+
+bool Simulator::replay_trace(const std::string& path) {
+    TraceReader reader;
+    if (!reader.open(path))
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Trace allocation index -> block id returned by this run
+    std::vector<int> alloc_ids;
+    std::vector<TraceRecord> batch;
+    size_t records = 0, allocs = 0, frees = 0, reallocs = 0, accesses = 0;
+
+    while (reader.next_batch(batch)) {
+        for (const TraceRecord& r : batch) {
+            switch (r.op) {
+            case TraceOp::ALLOC:
+                alloc_ids.push_back(mem.malloc_block(r.value));
+                tick(0);
+                allocs++;
+                break;
+            case TraceOp::ALIGNED_ALLOC:
+                alloc_ids.push_back(mem.malloc_aligned(r.value, r.arg));
+                tick(0);
+                allocs++;
+                break;
+            case TraceOp::REALLOC:
+                if (r.value < alloc_ids.size() && alloc_ids[r.value] != -1) {
+                    int old_id = alloc_ids[r.value];
+                    alloc_ids[r.value] = mem.realloc_block(old_id, r.arg);
+                    attribute_realloc(old_id, alloc_ids[r.value], r.arg);
+                }
+                tick(0);
+                reallocs++;
+                break;
+            case TraceOp::FREE:
+                if (r.value < alloc_ids.size() && alloc_ids[r.value] != -1) {
+                    mem.free_block(alloc_ids[r.value]);
+                    attribution.retire(alloc_ids[r.value]);
+                    alloc_ids[r.value] = -1;
+                }
+                tick(0);
+                frees++;
+                break;
+            case TraceOp::ACCESS:
+            case TraceOp::WRITE:
+                access(r.value, r.op == TraceOp::WRITE);
+                accesses++;
+                break;
+            case TraceOp::TENANT:
+                switch_tenant((int)r.value);
+                break;
+            }
+        }
+        records += batch.size();
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    MEMSIM_SUMMARY("Replayed " << records << " records ("
+                   << allocs << " allocs, " << frees << " frees, "
+                   << reallocs << " reallocs, "
+                   << accesses << " accesses) from "
+                   << reader.bytes_read() << " bytes in " << ms << " ms\n");
+    if (reader.failed())
+        MEMSIM_SUMMARY("Trace is truncated or corrupt\n");
+    return true;
+}
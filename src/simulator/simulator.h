@@ -0,0 +1,88 @@
+#pragma once
+#include <string_view>
+#include "../allocator/memory_manager.h"
+#include "../cache/cache.h"
+#include "../virtual_memory/VirtualMemory.h"
+#include "../io/tokenizer.h"
+#include "../trace/trace_writer.h"
+#include "../stats/stats_registry.h"
+#include "../workload/workload_generator.h"
+#include "../attribution/miss_attribution.h"
+#include "../qos/bandwidth_throttle.h"
+#include <string>
+#include <unordered_map>
+
+// Owns every simulated component and runs REPL commands against them.
+class Simulator {
+public:
+    Simulator();
+
+    // Executes one command line; returns false on exit
+    bool execute(std::string_view line);
+
+    // Runs an address through VM -> L1 -> L2 -> memory, returns cycles
+    int access(size_t virtual_addr, bool write);
+
+    MemoryManager& memory() { return mem; }
+    VirtualMemory& virtual_memory() { return vm; }
+    Cache& l1_cache() { return l1; }
+    Cache& l2_cache() { return l2; }
+
+    // Replays a compressed trace; returns false if it can't be read
+    bool replay_trace(const std::string& path);
+
+private:
+    MemoryManager mem;
+    Cache l1;
+    Cache l2;
+    VirtualMemory vm;
+
+    // Commands are appended here while "trace record" is active
+    TraceWriter recorder;
+    std::unordered_map<int, uint64_t> recorded_ids;   // block id -> allocation index
+
+    // Time series written while "stats record" is active
+    StatsRegistry series;
+    void register_stats();
+    void tick(int cycles) { series.tick(cycles); }
+
+    // Misses per allocation while "attribution on" is active
+    MissAttribution attribution;
+    void attribute_realloc(int old_id, int new_id, size_t size);
+
+    // Tenant of the accesses that follow, for cache partitions and the
+    // memory bandwidth limits
+    int tenant = 0;
+    BandwidthThrottle bandwidth;
+    void switch_tenant(int id);
+
+    // Phases queued by "workload phase" for the next run
+    WorkloadConfig workload;
+    class LiveSink;
+
+    // One operation as the REPL runs it, including trace recording
+    int do_malloc(size_t size);
+    bool do_free(int id);
+    void do_access(size_t virtual_addr, bool write);
+
+    void cmd_init(Tokenizer& tok);
+    void cmd_dump(Tokenizer& tok);
+    void cmd_malloc(Tokenizer& tok);
+    void cmd_free(Tokenizer& tok);
+    void cmd_realloc(Tokenizer& tok);
+    void cmd_malloc_aligned(Tokenizer& tok);
+    void cmd_compact(Tokenizer& tok);
+    void cmd_buddy(Tokenizer& tok);
+    void cmd_attribution(Tokenizer& tok);
+    void cmd_qos(Tokenizer& tok);
+    void cmd_stats(Tokenizer& tok);
+    void cmd_set(Tokenizer& tok);
+    void cmd_access(Tokenizer& tok, bool write);
+    void cmd_cache(Tokenizer& tok);
+    void cmd_vm(Tokenizer& tok);
+    void cmd_tlb(Tokenizer& tok);
+    void cmd_trace(Tokenizer& tok);
+    void cmd_profile(Tokenizer& tok);
+    void cmd_workload(Tokenizer& tok);
+    void cmd_checkpoint(Tokenizer& tok);
+};
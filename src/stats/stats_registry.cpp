@@ -0,0 +1,91 @@
+#include "stats_registry.h"
+#include <cmath>
+
+StatsRegistry::StatsRegistry()
+    : file(nullptr),
+      format(StatsFormat::JSON_LINES),
+      interval(1),
+      by_cycles(false),
+      next_sample(0),
+      ops(0),
+      cycles(0),
+      sampled_ops(0),
+      samples(0) {}
+
+StatsRegistry::~StatsRegistry() {
+    close();
+}
+
+void StatsRegistry::add(const std::string& name, Reader read) {
+    gauges.push_back({name, std::move(read)});
+}
+
+bool StatsRegistry::open(const std::string& path, StatsFormat format,
+                         uint64_t interval, bool by_cycles) {
+    close();
+    file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    this->format = format;
+    this->interval = interval ? interval : 1;
+    this->by_cycles = by_cycles;
+    next_sample = this->interval;
+    ops = 0;
+    cycles = 0;
+    sampled_ops = 0;
+    samples = 0;
+
+    if (format == StatsFormat::CSV) {
+        std::fputs("ops,cycles", file);
+        for (const Gauge& g : gauges)
+            std::fprintf(file, ",%s", g.name.c_str());
+        std::fputc('\n', file);
+    }
+    return true;
+}
+
+void StatsRegistry::close() {
+    if (!file)
+        return;
+
+    // Final sample unless one was just taken
+    if (samples == 0 || sampled_ops != ops)
+        sample();
+
+    std::fclose(file);
+    file = nullptr;
+}
+
+// Counters print as integers, rates with fixed precision
+void StatsRegistry::write_value(double value) {
+    if (value == std::floor(value) && std::fabs(value) < 1e15)
+        std::fprintf(file, "%.0f", value);
+    else
+        std::fprintf(file, "%.6f", value);
+}
+
+void StatsRegistry::sample() {
+    uint64_t now = by_cycles ? cycles : ops;
+    next_sample = (now / interval + 1) * interval;
+    sampled_ops = ops;
+    samples++;
+
+    if (format == StatsFormat::CSV) {
+        std::fprintf(file, "%llu,%llu", (unsigned long long)ops,
+                     (unsigned long long)cycles);
+        for (const Gauge& g : gauges) {
+            std::fputc(',', file);
+            write_value(g.read());
+        }
+    } else {
+        std::fprintf(file, "{\"ops\":%llu,\"cycles\":%llu", (unsigned long long)ops,
+                     (unsigned long long)cycles);
+        for (const Gauge& g : gauges) {
+            std::fprintf(file, ",\"%s\":", g.name.c_str());
+            write_value(g.read());
+        }
+        std::fputc('}', file);
+    }
+    std::fputc('\n', file);
+}
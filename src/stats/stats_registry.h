@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class StatsFormat {
+    JSON_LINES,
+    CSV
+};
+
+// Named readings of the simulated components, sampled into a time series.
+// Every reader must be O(1); sampling happens while the workload runs.
+class StatsRegistry {
+public:
+    using Reader = std::function<double()>;
+
+    StatsRegistry();
+    ~StatsRegistry();
+
+    void add(const std::string& name, Reader read);
+
+    // Samples every interval operations, or simulated cycles if by_cycles
+    bool open(const std::string& path, StatsFormat format,
+              uint64_t interval, bool by_cycles);
+    // Writes a final sample and closes the file
+    void close();
+    bool is_open() const { return file != nullptr; }
+
+    // Counts one operation that took the given cycles
+    void tick(uint64_t op_cycles) {
+        ops++;
+        cycles += op_cycles;
+        if (file && (by_cycles ? cycles : ops) >= next_sample)
+            sample();
+    }
+
+    size_t samples_written() const { return samples; }
+
+private:
+    struct Gauge {
+        std::string name;
+        Reader read;
+    };
+
+    std::vector<Gauge> gauges;
+    FILE* file;
+    StatsFormat format;
+    uint64_t interval;
+    bool by_cycles;
+    uint64_t next_sample;
+    uint64_t ops;
+    uint64_t cycles;
+    uint64_t sampled_ops;   // ops at the last sample
+    size_t samples;
+
+    void sample();
+    void write_value(double value);
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+
+// Raw allocation log written by the LD_PRELOAD recorder
+// (src/preload/malloc_recorder.cpp). The file is the magic and version
+// followed by fixed-size events. Each thread flushes its own buffer, so
+// events are only ordered by time within a thread.
+
+const uint32_t ALLOC_LOG_MAGIC = 0x4c41534d;   // "MSAL"
+const uint32_t ALLOC_LOG_VERSION = 2;
+
+enum AllocEventOp : uint32_t {
+    EVENT_MALLOC,
+    EVENT_FREE,
+    EVENT_REALLOC,
+    EVENT_CALLOC,
+    EVENT_MEMALIGN,
+    EVENT_REALLOC_START     // stamped before EVENT_REALLOC on the same thread
+};
+
+struct AllocEvent {
+    uint64_t time_ns;   // CLOCK_MONOTONIC
+    uint64_t ptr;       // returned (or freed) pointer; realloc start: old pointer
+    uint64_t arg;       // realloc: old pointer, memalign: alignment
+    uint64_t size;      // bytes requested
+    uint32_t thread;
+    uint32_t op;
+};
@@ -0,0 +1,122 @@
+#include "alloc_import.h"
+#include "alloc_event.h"
+#include "trace_writer.h"
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+bool import_alloc_log(const std::string& log_path, const std::string& trace_path,
+                      AllocImportStats& stats) {
+    stats = AllocImportStats{};
+
+    FILE* in = std::fopen(log_path.c_str(), "rb");
+    if (!in)
+        return false;
+
+    uint32_t header[2];
+    if (std::fread(header, sizeof(header), 1, in) != 1 ||
+        header[0] != ALLOC_LOG_MAGIC || header[1] != ALLOC_LOG_VERSION) {
+        std::fclose(in);
+        return false;
+    }
+
+    std::vector<AllocEvent> events;
+    AllocEvent e;
+    while (std::fread(&e, sizeof(e), 1, in) == 1)
+        events.push_back(e);
+    std::fclose(in);
+
+    // Threads flush whole buffers, so the file is only ordered per thread
+    std::stable_sort(events.begin(), events.end(),
+        [](const AllocEvent& a, const AllocEvent& b) { return a.time_ns < b.time_ns; });
+
+    TraceWriter writer;
+    if (!writer.open(trace_path))
+        return false;
+
+    std::unordered_map<uint64_t, uint64_t> live;     // pointer -> allocation index
+    std::unordered_set<uint32_t> threads;
+    // thread -> old pointer and allocation index of its realloc in progress
+    std::unordered_map<uint32_t, std::pair<uint64_t, uint64_t>> reallocating;
+
+    auto allocate = [&](uint64_t ptr, uint64_t size, uint64_t align) {
+        if (!ptr)
+            return;
+        live[ptr] = writer.allocations();
+        if (align > 0)
+            writer.append(TraceOp::ALIGNED_ALLOC, size, align);
+        else
+            writer.append(TraceOp::ALLOC, size);
+        stats.allocs++;
+    };
+    auto release = [&](uint64_t ptr) {
+        auto it = live.find(ptr);
+        if (it == live.end()) {
+            stats.unmatched_frees++;
+            return;
+        }
+        writer.append(TraceOp::FREE, it->second);
+        live.erase(it);
+        stats.frees++;
+    };
+
+    for (const AllocEvent& ev : events) {
+        threads.insert(ev.thread);
+
+        switch (ev.op) {
+        case EVENT_MALLOC:
+        case EVENT_CALLOC:
+            allocate(ev.ptr, ev.size, 0);
+            break;
+        case EVENT_MEMALIGN:
+            allocate(ev.ptr, ev.size, ev.arg);
+            break;
+        case EVENT_FREE:
+            release(ev.ptr);
+            break;
+        case EVENT_REALLOC_START: {
+            // The old block leaves the live set now: another thread may be
+            // handed its address before this realloc returns
+            auto it = live.find(ev.ptr);
+            if (it == live.end()) {
+                reallocating.erase(ev.thread);
+            } else {
+                reallocating[ev.thread] = {ev.ptr, it->second};
+                live.erase(it);
+            }
+            break;
+        }
+        case EVENT_REALLOC: {
+            stats.reallocs++;
+            auto it = reallocating.find(ev.thread);
+            if (!ev.arg || it == reallocating.end() || it->second.first != ev.arg) {
+                // realloc(NULL, n), or of a pointer from before recording
+                allocate(ev.ptr, ev.size, 0);
+                break;
+            }
+            uint64_t index = it->second.second;
+            reallocating.erase(it);
+            if (ev.size == 0) {
+                writer.append(TraceOp::FREE, index);
+                stats.frees++;
+            } else if (!ev.ptr) {
+                // Failed: the old block is still live
+                live[ev.arg] = index;
+            } else {
+                // The allocation keeps its index across the resize
+                live[ev.ptr] = index;
+                writer.append(TraceOp::REALLOC, index, ev.size);
+            }
+            break;
+        }
+        }
+    }
+
+    writer.close();
+    stats.events = events.size();
+    stats.threads = threads.size();
+    return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+struct AllocImportStats {
+    size_t events;
+    size_t threads;
+    size_t allocs;
+    size_t frees;
+    size_t reallocs;
+    size_t unmatched_frees;    // pointer allocated before recording started
+};
+
+// Converts a raw log from the LD_PRELOAD recorder into a compressed
+// memsim trace. Pointers become allocation indices; events of all
+// threads are merged in timestamp order.
+bool import_alloc_log(const std::string& log_path, const std::string& trace_path,
+                      AllocImportStats& stats);
@@ -0,0 +1,120 @@
+#include "trace_format.h"
+
+void encode_block(const std::vector<TraceRecord>& records,
+                  uint64_t& alloc_base, std::vector<uint8_t>& payload) {
+    payload.clear();
+    uint64_t prev_addr = 0;
+
+    size_t i = 0;
+    while (i < records.size()) {
+        TraceOp op = records[i].op;
+        size_t run = 1;
+        while (i + run < records.size() && records[i + run].op == op)
+            run++;
+
+        payload.push_back((uint8_t)op);
+        put_varint(payload, run);
+
+        for (size_t k = i; k < i + run; k++) {
+            uint64_t value = records[k].value;
+            switch (op) {
+            case TraceOp::ALLOC:
+                put_varint(payload, value);
+                alloc_base++;
+                break;
+            case TraceOp::FREE:
+                // Recent allocations encode as small distances
+                put_varint(payload, alloc_base - value - 1);
+                break;
+            case TraceOp::REALLOC:
+                put_varint(payload, alloc_base - value - 1);
+                put_varint(payload, records[k].arg);
+                break;
+            case TraceOp::ALIGNED_ALLOC: {
+                uint64_t shift = 0;
+                while (((uint64_t)1 << shift) < records[k].arg)
+                    shift++;
+                put_varint(payload, shift);
+                put_varint(payload, value);
+                alloc_base++;
+                break;
+            }
+            case TraceOp::ACCESS:
+            case TraceOp::WRITE:
+                put_varint(payload, zigzag((int64_t)(value - prev_addr)));
+                prev_addr = value;
+                break;
+            case TraceOp::TENANT:
+                put_varint(payload, value);
+                break;
+            }
+        }
+        i += run;
+    }
+}
+
+bool decode_block(const TraceBlockHeader& header, uint32_t version,
+                  const uint8_t* payload, std::vector<TraceRecord>& records) {
+    if (!valid_block_header(header))
+        return false;
+
+    const uint8_t* p = payload;
+    const uint8_t* end = payload + header.payload_bytes;
+    uint64_t alloc_count = header.alloc_base;
+    uint64_t prev_addr = 0;
+
+    records.clear();
+    records.reserve(header.record_count);
+
+    while (p < end) {
+        uint8_t op_byte = *p++;
+        if (op_byte > (uint8_t)TraceOp::TENANT)
+            return false;
+        TraceOp op = (TraceOp)op_byte;
+        if (op_version(op) > version)
+            return false;
+
+        uint64_t run;
+        if (!get_varint(p, end, run) || records.size() + run > header.record_count)
+            return false;
+
+        for (uint64_t k = 0; k < run; k++) {
+            uint64_t v, arg = 0;
+            if (!get_varint(p, end, v))
+                return false;
+
+            switch (op) {
+            case TraceOp::ALLOC:
+                alloc_count++;
+                break;
+            case TraceOp::FREE:
+                if (v >= alloc_count)
+                    return false;
+                v = alloc_count - v - 1;
+                break;
+            case TraceOp::REALLOC:
+                if (v >= alloc_count || !get_varint(p, end, arg))
+                    return false;
+                v = alloc_count - v - 1;
+                break;
+            case TraceOp::ALIGNED_ALLOC:
+                if (v >= 64)
+                    return false;
+                arg = (uint64_t)1 << v;
+                if (!get_varint(p, end, v))
+                    return false;
+                alloc_count++;
+                break;
+            case TraceOp::ACCESS:
+            case TraceOp::WRITE:
+                v = prev_addr + (uint64_t)unzigzag(v);
+                prev_addr = v;
+                break;
+            case TraceOp::TENANT:
+                break;
+            }
+            records.push_back({op, v, arg});
+        }
+    }
+    return records.size() == header.record_count;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compressed trace of allocation and access streams.
+//
+// File:    "MSTR" magic, u32 version, then blocks until end of file.
+// Block:   u32 record_count, u32 payload_bytes, u64 alloc_base, payload.
+// Payload: runs of [op byte][varint run length][run length values]:
+//   ALLOC         varint size
+//   FREE          varint (allocations so far - allocation index - 1)
+//   ACCESS/WRITE  zigzag varint delta from the previous address
+//   REALLOC       varint allocation distance (as FREE), varint new size
+//   ALIGNED_ALLOC varint log2(alignment), varint size
+//
+// Every block starts from address 0 and carries the number of
+// allocations before it, so blocks decode independently of each other.
+
+enum class TraceOp : uint8_t {
+    ALLOC,
+    FREE,
+    ACCESS,
+    WRITE,
+    REALLOC,        // added in version 2
+    ALIGNED_ALLOC,  // added in version 2
+    TENANT          // added in version 3: later records belong to tenant value
+};
+
+struct TraceRecord {
+    TraceOp op;
+    uint64_t value;     // size, allocation index or address
+    uint64_t arg;       // REALLOC: new size, ALIGNED_ALLOC: alignment
+};
+
+const uint32_t TRACE_MAGIC = 0x5254534d;   // "MSTR"
+const uint32_t TRACE_VERSION = 3;     // readers accept 1..TRACE_VERSION
+const size_t TRACE_BLOCK_RECORDS = 1 << 16;
+
+struct TraceBlockHeader {
+    uint32_t record_count;
+    uint32_t payload_bytes;
+    uint64_t alloc_base;
+};
+
+// A record takes at most an op byte and a run length (when it starts a
+// run) and two varints
+const size_t TRACE_MAX_RECORD_BYTES = 1 + 3 * 10;
+
+// Checked before anything is allocated for the block
+inline bool valid_block_header(const TraceBlockHeader& header) {
+    return header.record_count <= TRACE_BLOCK_RECORDS &&
+           header.payload_bytes <= header.record_count * TRACE_MAX_RECORD_BYTES;
+}
+
+// First format version that has the op
+inline uint32_t op_version(TraceOp op) {
+    switch (op) {
+    case TraceOp::REALLOC:
+    case TraceOp::ALIGNED_ALLOC:
+        return 2;
+    case TraceOp::TENANT:
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+inline void put_varint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+// Returns false if the varint runs past end
+inline bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+inline uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Encodes records into a block payload; alloc_base is updated to count
+// the allocations in this block
+void encode_block(const std::vector<TraceRecord>& records,
+                  uint64_t& alloc_base, std::vector<uint8_t>& payload);
+
+// Decodes one block payload of a file in the given format version;
+// returns false on corrupt input or ops the version does not have
+bool decode_block(const TraceBlockHeader& header, uint32_t version,
+                  const uint8_t* payload, std::vector<TraceRecord>& records);
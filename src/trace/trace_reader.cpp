@@ -0,0 +1,120 @@
+#include "trace_reader.h"
+
+TraceReader::TraceReader(size_t prefetch_batches)
+    : file(nullptr),
+      version(0),
+      ring(prefetch_batches < 2 ? 2 : prefetch_batches),
+      head(0),
+      count(0),
+      finished(true),
+      stopping(false),
+      corrupt(false),
+      total_bytes(0) {}
+
+TraceReader::~TraceReader() {
+    close();
+}
+
+bool TraceReader::open(const std::string& path) {
+    close();
+    file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    uint32_t header[2];
+    if (std::fread(header, sizeof(header), 1, file) != 1 ||
+        header[0] != TRACE_MAGIC || header[1] == 0 || header[1] > TRACE_VERSION) {
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    version = header[1];
+    head = 0;
+    count = 0;
+    finished = false;
+    stopping = false;
+    corrupt = false;
+    total_bytes = sizeof(header);
+
+    decoder = std::thread(&TraceReader::decode_loop, this);
+    return true;
+}
+
+void TraceReader::close() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    not_full.notify_all();
+
+    if (decoder.joinable())
+        decoder.join();
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+void TraceReader::decode_loop() {
+    std::vector<uint8_t> payload;
+    std::vector<TraceRecord> batch;
+    bool bad = false;
+
+    while (true) {
+        // End of file only between blocks; part of a header is truncation
+        TraceBlockHeader header;
+        size_t got = std::fread(&header, 1, sizeof(header), file);
+        if (got == 0)
+            break;
+
+        if (got != sizeof(header) || !valid_block_header(header)) {
+            bad = true;
+            break;
+        }
+        payload.resize(header.payload_bytes);
+        if (std::fread(payload.data(), 1, payload.size(), file) != payload.size() ||
+            !decode_block(header, version, payload.data(), batch)) {
+            bad = true;
+            break;
+        }
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            total_bytes += sizeof(header) + payload.size();
+            not_full.wait(guard, [&] { return count < ring.size() || stopping; });
+            if (stopping)
+                return;
+            publish(batch);
+        }
+        not_empty.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        finished = true;
+        corrupt = bad;
+    }
+    not_empty.notify_all();
+}
+
+// Caller holds the lock
+void TraceReader::publish(std::vector<TraceRecord>& batch) {
+    ring[(head + count) % ring.size()].swap(batch);
+    count++;
+}
+
+bool TraceReader::next_batch(std::vector<TraceRecord>& batch) {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        not_empty.wait(guard, [&] { return count > 0 || finished; });
+        if (count == 0)
+            return false;
+
+        ring[head].swap(batch);
+        head = (head + 1) % ring.size();
+        count--;
+    }
+    not_full.notify_one();
+    return true;
+}
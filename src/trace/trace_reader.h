@@ -0,0 +1,48 @@
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "trace_format.h"
+
+// Reads a compressed trace on a background thread. Decoded blocks are
+// handed over through a small ring of batches, so decoding the next
+// block overlaps with simulating the current one.
+class TraceReader {
+public:
+    explicit TraceReader(size_t prefetch_batches = 4);
+    ~TraceReader();
+
+    bool open(const std::string& path);
+    void close();
+
+    // Swaps the next decoded batch into batch (the old contents are
+    // recycled). Blocks until one is ready; false at end of trace.
+    bool next_batch(std::vector<TraceRecord>& batch);
+
+    // True if decoding stopped on a truncated or corrupt block
+    bool failed() const { return corrupt; }
+    size_t bytes_read() const { return total_bytes; }
+
+private:
+    FILE* file;
+    uint32_t version;   // of the open file
+    std::thread decoder;
+
+    std::mutex lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+    std::vector<std::vector<TraceRecord>> ring;
+    size_t head;
+    size_t count;
+    bool finished;
+    bool stopping;
+    bool corrupt;
+    size_t total_bytes;
+
+    void decode_loop();
+    void publish(std::vector<TraceRecord>& batch);
+};
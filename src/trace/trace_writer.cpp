@@ -0,0 +1,66 @@
+#include "trace_writer.h"
+
+TraceWriter::TraceWriter()
+    : file(nullptr),
+      alloc_base(0),
+      alloc_count(0),
+      total_records(0),
+      total_bytes(0) {}
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const std::string& path) {
+    close();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    uint32_t header[2] = {TRACE_MAGIC, TRACE_VERSION};
+    std::fwrite(header, sizeof(header), 1, file);
+
+    pending.clear();
+    pending.reserve(TRACE_BLOCK_RECORDS);
+    alloc_base = 0;
+    alloc_count = 0;
+    total_records = 0;
+    total_bytes = sizeof(header);
+    return true;
+}
+
+void TraceWriter::append(TraceOp op, uint64_t value, uint64_t arg) {
+    if (op == TraceOp::ALLOC || op == TraceOp::ALIGNED_ALLOC)
+        alloc_count++;
+
+    pending.push_back({op, value, arg});
+    if (pending.size() == TRACE_BLOCK_RECORDS)
+        flush_block();
+}
+
+void TraceWriter::flush_block() {
+    if (pending.empty())
+        return;
+
+    TraceBlockHeader header;
+    header.record_count = (uint32_t)pending.size();
+    header.alloc_base = alloc_base;
+    encode_block(pending, alloc_base, payload);
+    header.payload_bytes = (uint32_t)payload.size();
+
+    std::fwrite(&header, sizeof(header), 1, file);
+    std::fwrite(payload.data(), 1, payload.size(), file);
+
+    total_records += pending.size();
+    total_bytes += sizeof(header) + payload.size();
+    pending.clear();
+}
+
+void TraceWriter::close() {
+    if (!file)
+        return;
+
+    flush_block();
+    std::fclose(file);
+    file = nullptr;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "trace_format.h"
+
+// Buffers records and writes them out one compressed block at a time.
+class TraceWriter {
+public:
+    TraceWriter();
+    ~TraceWriter();
+
+    bool open(const std::string& path);
+    void append(TraceOp op, uint64_t value, uint64_t arg = 0);
+    void close();
+
+    bool is_open() const { return file != nullptr; }
+    uint64_t allocations() const { return alloc_count; }
+    size_t records_written() const { return total_records; }
+    size_t bytes_written() const { return total_bytes; }
+
+private:
+    FILE* file;
+    std::vector<TraceRecord> pending;
+    std::vector<uint8_t> payload;
+    uint64_t alloc_base;     // allocations in blocks already written
+    uint64_t alloc_count;    // allocations appended so far
+    size_t total_records;
+    size_t total_bytes;
+
+    void flush_block();
+};
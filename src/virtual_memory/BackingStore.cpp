@@ -0,0 +1,226 @@
+#include "BackingStore.h"
+#include <algorithm>
+#include <iostream>
+#include "../io/output.h"
+#include "../checkpoint/checkpoint.h"
+
+BackingStore::BackingStore()
+    : is_enabled(false),
+      cfg{0, 0, 1, 0, 1},
+      pending_writebacks(0),
+      reads(0),
+      write_requests(0),
+      pages_written(0),
+      queue_wait_cycles(0),
+      readahead_issued(0),
+      readahead_hits(0),
+      readahead_wasted(0),
+      inflight_waits(0),
+      inflight_wait_cycles(0),
+      fault_buckets{},
+      fault_count(0),
+      fault_cycles(0),
+      fault_min(0),
+      fault_max(0) {}
+
+void BackingStore::configure(const BackingStoreConfig& config) {
+    is_enabled = true;
+    cfg = config;
+    cfg.queue_depth = std::max(cfg.queue_depth, 1);
+    cfg.writeback_batch = std::max(cfg.writeback_batch, 1);
+    cfg.readahead = std::max(cfg.readahead, 0);
+
+    slot_free_at.assign(cfg.queue_depth, 0);
+    pending_writebacks = 0;
+    reads = 0;
+    write_requests = 0;
+    pages_written = 0;
+    queue_wait_cycles = 0;
+    readahead_issued = 0;
+    readahead_hits = 0;
+    readahead_wasted = 0;
+    inflight_waits = 0;
+    inflight_wait_cycles = 0;
+    std::fill(std::begin(fault_buckets), std::end(fault_buckets), 0);
+    fault_count = 0;
+    fault_cycles = 0;
+    fault_min = 0;
+    fault_max = 0;
+}
+
+// Places a request on the queue slot that frees up first
+size_t BackingStore::submit(size_t now, int pages) {
+    auto slot = std::min_element(slot_free_at.begin(), slot_free_at.end());
+    size_t start = std::max(now, *slot);
+    queue_wait_cycles += start - now;
+
+    *slot = start + cfg.latency + (size_t)cfg.transfer * pages;
+    return *slot;
+}
+
+size_t BackingStore::read_page(size_t now) {
+    reads++;
+    return submit(now, 1);
+}
+
+void BackingStore::write_back(size_t now) {
+    if (++pending_writebacks < cfg.writeback_batch)
+        return;
+
+    submit(now, pending_writebacks);
+    write_requests++;
+    pages_written += pending_writebacks;
+    pending_writebacks = 0;
+}
+
+void BackingStore::record_fault(size_t service_cycles) {
+    int bucket = 0;
+    while (bucket < NUM_BUCKETS - 1 && (size_t(1) << (bucket + 1)) <= service_cycles)
+        bucket++;
+    fault_buckets[bucket]++;
+
+    if (fault_count == 0 || service_cycles < fault_min)
+        fault_min = service_cycles;
+    fault_max = std::max(fault_max, service_cycles);
+    fault_count++;
+    fault_cycles += service_cycles;
+}
+
+void BackingStore::count_inflight_wait(size_t cycles) {
+    inflight_waits++;
+    inflight_wait_cycles += cycles;
+}
+
+// Upper bound of the bucket holding the p-th percentile
+size_t BackingStore::fault_percentile(double p) const {
+    size_t target = (size_t)(p * fault_count + 0.999999);
+    size_t seen = 0;
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        seen += fault_buckets[b];
+        if (seen >= target)
+            return std::min(fault_max, (size_t(1) << (b + 1)) - 1);
+    }
+    return fault_max;
+}
+
+void BackingStore::print_stats() const {
+    std::ostream& out = Output::stream();
+
+    if (!is_enabled) {
+        out << "Backing store disabled\n";
+        return;
+    }
+
+    out << "Backing store: latency " << cfg.latency
+        << ", transfer " << cfg.transfer << " cycles/page"
+        << ", queue depth " << cfg.queue_depth << "\n";
+    out << "Page reads: " << reads << "\n";
+    out << "Write-back requests: " << write_requests
+        << " (" << pages_written << " pages, "
+        << pending_writebacks << " pending)\n";
+    out << "Queue wait: " << queue_wait_cycles << " cycles\n";
+
+    out << "Readahead pages: " << readahead_issued << "\n";
+    out << "Readahead used: " << readahead_hits << "\n";
+    out << "Readahead wasted: " << readahead_wasted << "\n";
+    out << "Waits on in-flight pages: " << inflight_waits
+        << " (" << inflight_wait_cycles << " cycles)\n";
+
+    out << "Fault service time (cycles):\n";
+    if (fault_count == 0) {
+        out << "  no faults\n";
+        return;
+    }
+    out << "  min " << fault_min
+        << ", avg " << (double)fault_cycles / fault_count
+        << ", max " << fault_max << "\n";
+    out << "  p50 <= " << fault_percentile(0.50)
+        << ", p90 <= " << fault_percentile(0.90)
+        << ", p99 <= " << fault_percentile(0.99) << "\n";
+
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        if (fault_buckets[b] == 0)
+            continue;
+        out << "  [" << (b == 0 ? 0 : size_t(1) << b) << ", "
+            << (size_t(1) << (b + 1)) << "): "
+            << fault_buckets[b] << "\n";
+    }
+}
+
+struct SwapCheckpoint {
+    bool is_enabled;
+    BackingStoreConfig cfg;
+    int pending_writebacks;
+    size_t reads;
+    size_t write_requests;
+    size_t pages_written;
+    size_t queue_wait_cycles;
+    size_t readahead_issued;
+    size_t readahead_hits;
+    size_t readahead_wasted;
+    size_t inflight_waits;
+    size_t inflight_wait_cycles;
+    size_t fault_buckets[48];
+    size_t fault_count;
+    size_t fault_cycles;
+    size_t fault_min;
+    size_t fault_max;
+};
+
+void BackingStore::save(CheckpointWriter& out) const {
+    static_assert(NUM_BUCKETS == 48, "SwapCheckpoint::fault_buckets");
+    SwapCheckpoint state {is_enabled, cfg, pending_writebacks, reads, write_requests,
+                          pages_written, queue_wait_cycles, readahead_issued,
+                          readahead_hits, readahead_wasted, inflight_waits,
+                          inflight_wait_cycles, {}, fault_count, fault_cycles,
+                          fault_min, fault_max};
+    std::copy(fault_buckets, fault_buckets + NUM_BUCKETS, state.fault_buckets);
+    out.add_value(SectionId::SWAP_STATE, state);
+    out.add(SectionId::SWAP_SLOTS, slot_free_at);
+}
+
+// An enabled store has one slot per unit of queue depth
+static const size_t* read_swap(const CheckpointReader& in, SwapCheckpoint& state,
+                               size_t& count) {
+    const size_t* slots = in.get<size_t>(SectionId::SWAP_SLOTS, count);
+    if (!in.get_value(SectionId::SWAP_STATE, state) || !slots)
+        return nullptr;
+    if (state.is_enabled && (state.cfg.queue_depth < 1 ||
+                             count != (size_t)state.cfg.queue_depth))
+        return nullptr;
+    return slots;
+}
+
+bool BackingStore::can_load(const CheckpointReader& in) const {
+    SwapCheckpoint state;
+    size_t count = 0;
+    return read_swap(in, state, count) != nullptr;
+}
+
+bool BackingStore::load(const CheckpointReader& in) {
+    SwapCheckpoint state;
+    size_t count = 0;
+    const size_t* slots = read_swap(in, state, count);
+    if (!slots)
+        return false;
+
+    is_enabled = state.is_enabled;
+    cfg = state.cfg;
+    pending_writebacks = state.pending_writebacks;
+    reads = state.reads;
+    write_requests = state.write_requests;
+    pages_written = state.pages_written;
+    queue_wait_cycles = state.queue_wait_cycles;
+    readahead_issued = state.readahead_issued;
+    readahead_hits = state.readahead_hits;
+    readahead_wasted = state.readahead_wasted;
+    inflight_waits = state.inflight_waits;
+    inflight_wait_cycles = state.inflight_wait_cycles;
+    std::copy(state.fault_buckets, state.fault_buckets + NUM_BUCKETS, fault_buckets);
+    fault_count = state.fault_count;
+    fault_cycles = state.fault_cycles;
+    fault_min = state.fault_min;
+    fault_max = state.fault_max;
+    slot_free_at.assign(slots, slots + count);
+    return true;
+}
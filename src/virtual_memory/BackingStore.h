@@ -0,0 +1,79 @@
+#ifndef BACKING_STORE_H
+#define BACKING_STORE_H
+
+#include <cstddef>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Swap device behind the page table. Requests are asynchronous: each one
+// occupies a queue slot until it completes, so up to queue_depth reads and
+// write-backs can be in flight at once.
+struct BackingStoreConfig {
+    int latency;            // cycles of fixed cost per request
+    int transfer;           // cycles per page moved
+    int queue_depth;
+    int readahead;          // pages fetched ahead on sequential faults
+    int writeback_batch;    // dirty pages gathered per write request
+};
+
+class BackingStore {
+public:
+    BackingStore();
+
+    void configure(const BackingStoreConfig& config);
+    bool enabled() const { return is_enabled; }
+    int readahead_window() const { return cfg.readahead; }
+
+    // Issues a page read at time now; returns its completion time
+    size_t read_page(size_t now);
+    // Queues a dirty page for write-back, flushing a full batch
+    void write_back(size_t now);
+
+    void record_fault(size_t service_cycles);
+    void count_readahead() { readahead_issued++; }
+    void count_readahead_hit() { readahead_hits++; }
+    void count_readahead_wasted() { readahead_wasted++; }
+    void count_inflight_wait(size_t cycles);
+
+    void print_stats() const;
+
+    // Includes requests still in flight on the queue slots
+    void save(CheckpointWriter& out) const;
+    bool can_load(const CheckpointReader& in) const;
+    bool load(const CheckpointReader& in);
+
+private:
+    static const int NUM_BUCKETS = 48;
+
+    bool is_enabled;
+    BackingStoreConfig cfg;
+
+    // Time at which each queue slot becomes free
+    std::vector<size_t> slot_free_at;
+    int pending_writebacks;
+
+    size_t reads;
+    size_t write_requests;
+    size_t pages_written;
+    size_t queue_wait_cycles;
+
+    size_t readahead_issued;
+    size_t readahead_hits;
+    size_t readahead_wasted;
+    size_t inflight_waits;
+    size_t inflight_wait_cycles;
+
+    // Fault service times in power-of-two buckets
+    size_t fault_buckets[NUM_BUCKETS];
+    size_t fault_count;
+    size_t fault_cycles;
+    size_t fault_min;
+    size_t fault_max;
+
+    size_t submit(size_t now, int pages);
+    size_t fault_percentile(double p) const;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef STATIC_TLB_H
+#define STATIC_TLB_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+struct TLBEntry {
+    int page_number;
+    int frame_number;
+};
+
+// A TLB with its size fixed at compile time; see StaticCache
+class TLBEngine {
+public:
+    virtual ~TLBEngine() = default;
+    // now must grow with every call; it orders entries for LRU
+    virtual bool lookup(int page_number, int& frame_number, size_t now) = 0;
+    virtual void insert(int page_number, int frame_number, size_t now) = 0;
+    virtual void invalidate(int page_number) = 0;
+
+    // Most recently used first, like TLB's LRU list
+    virtual std::vector<TLBEntry> export_entries() const = 0;
+    virtual void import_entries(const std::vector<TLBEntry>& entries) = 0;
+};
+
+// Entries / Ways sets of Ways entries with LRU replacement; both powers of
+// two. Ways == Entries is fully associative, as the dynamic TLB is.
+template <size_t Entries, size_t Ways>
+class StaticTLB final : public TLBEngine {
+    static_assert(Entries % Ways == 0, "ways must divide entries");
+    static constexpr size_t SETS = Entries / Ways;
+    static_assert((SETS & (SETS - 1)) == 0, "set count must be a power of two");
+
+public:
+    StaticTLB() {
+        clear();
+    }
+
+    bool lookup(int page_number, int& frame_number, size_t now) override {
+        Set& set = set_of(page_number);
+        for (size_t w = 0; w < Ways; w++) {
+            if (set.pages[w] == page_number) {
+                set.stamps[w] = now;
+                frame_number = set.frames[w];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert(int page_number, int frame_number, size_t now) override {
+        Set& set = set_of(page_number);
+        size_t victim = find(set, page_number);
+        if (victim == Ways) {
+            // Free slots have stamp 0, so this is the first free slot,
+            // otherwise the least recently used
+            victim = 0;
+            for (size_t w = 1; w < Ways; w++) {
+                if (set.stamps[w] < set.stamps[victim])
+                    victim = w;
+            }
+        }
+        set.pages[victim] = page_number;
+        set.frames[victim] = frame_number;
+        set.stamps[victim] = now;
+    }
+
+    void invalidate(int page_number) override {
+        Set& set = set_of(page_number);
+        size_t w = find(set, page_number);
+        if (w != Ways) {
+            set.pages[w] = FREE;
+            set.stamps[w] = 0;
+        }
+    }
+
+    std::vector<TLBEntry> export_entries() const override {
+        std::vector<std::pair<size_t, TLBEntry>> live;
+        for (const Set& set : sets) {
+            for (size_t w = 0; w < Ways; w++) {
+                if (set.pages[w] != FREE)
+                    live.push_back({set.stamps[w], {set.pages[w], set.frames[w]}});
+            }
+        }
+        std::sort(live.begin(), live.end(),
+                  [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        std::vector<TLBEntry> entries;
+        for (const auto& [stamp, entry] : live)
+            entries.push_back(entry);
+        return entries;
+    }
+
+    void import_entries(const std::vector<TLBEntry>& entries) override {
+        clear();
+        // Oldest first, so the most recent ones win a full set
+        for (size_t i = entries.size(); i-- > 0;)
+            insert(entries[i].page_number, entries[i].frame_number, entries.size() - i);
+    }
+
+private:
+    static constexpr int FREE = -1;     // page numbers are never negative
+
+    struct Set {
+        std::array<int, Ways> pages;
+        std::array<int, Ways> frames;
+        std::array<size_t, Ways> stamps;
+    };
+    std::array<Set, SETS> sets;
+
+    Set& set_of(int page_number) { return sets[(size_t)page_number & (SETS - 1)]; }
+
+    static size_t find(const Set& set, int page_number) {
+        for (size_t w = 0; w < Ways; w++) {
+            if (set.pages[w] == page_number)
+                return w;
+        }
+        return Ways;
+    }
+
+    void clear() {
+        for (Set& set : sets) {
+            set.pages.fill(FREE);
+            set.stamps.fill(0);
+        }
+    }
+};
+
+// Specialized engine for a TLB shape, or nullptr if none is compiled in
+std::unique_ptr<TLBEngine> make_tlb_engine(size_t entries, size_t ways);
+
+#endif
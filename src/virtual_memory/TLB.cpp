@@ -1,10 +1,26 @@
 #include "TLB.h"
+#include <algorithm>
 #include <iostream>
+#include "../io/output.h"
+#include "../profile/profiler.h"
+#include "../checkpoint/checkpoint.h"
 
 TLB::TLB(int size)
-    : capacity(size), hits(0), misses(0) {}
+    : capacity(size), hits(0), misses(0), time_counter(0) {
+    set_specialized(true);
+}
 
 bool TLB::lookup(int page_number, int &frame_number) {
+    MEMSIM_PROBE(TLB_LOOKUP);
+    if (engine) {
+        bool hit = engine->lookup(page_number, frame_number, ++time_counter);
+        if (hit)
+            hits++;
+        else
+            misses++;
+        return hit;
+    }
+
     auto it = table.find(page_number);
     if (it != table.end()) {
         hits++;
@@ -21,6 +37,11 @@ bool TLB::lookup(int page_number, int &frame_number) {
 }
 
 void TLB::insert(int page_number, int frame_number) {
+    if (engine) {
+        engine->insert(page_number, frame_number, ++time_counter);
+        return;
+    }
+
     if (table.size() >= capacity) {
    
         int lru_page = lru_list.back();
@@ -32,13 +53,156 @@ void TLB::insert(int page_number, int frame_number) {
     table[page_number] = {frame_number, lru_list.begin()};
 }
 
+void TLB::invalidate(int page_number) {
+    if (engine) {
+        engine->invalidate(page_number);
+        return;
+    }
+
+    auto it = table.find(page_number);
+    if (it == table.end())
+        return;
+
+    lru_list.erase(it->second.second);
+    table.erase(it);
+}
+
+// The dynamic TLB is fully associative
+void TLB::set_specialized(bool enabled) {
+    if (enabled && !engine) {
+        // Taken before engine is set, or entries() reads the empty engine
+        std::vector<TLBEntry> current = entries();
+        engine = make_tlb_engine(capacity, capacity);
+        if (engine) {
+            // Imported entries are stamped 1..n; later ones must be newer
+            engine->import_entries(current);
+            time_counter = std::max(time_counter, current.size());
+        }
+    } else if (!enabled && engine) {
+        std::vector<TLBEntry> current = engine->export_entries();
+        engine.reset();
+        table.clear();
+        lru_list.clear();
+        for (const TLBEntry& e : current) {
+            lru_list.push_back(e.page_number);
+            table[e.page_number] = {e.frame_number, std::prev(lru_list.end())};
+        }
+    }
+}
+
+std::vector<TLBEntry> TLB::entries() const {
+    if (engine)
+        return engine->export_entries();
+    std::vector<TLBEntry> current;
+    for (int page : lru_list)
+        current.push_back({page, table.at(page).first});
+    return current;
+}
+
 void TLB::print_stats() const {
-    std::cout << "TLB hits: " << hits << "\n";
-    std::cout << "TLB misses: " << misses << "\n";
+    std::ostream& out = Output::stream();
+
+    out << "TLB hits: " << hits << "\n";
+    out << "TLB misses: " << misses << "\n";
 
     int total = hits + misses;
     if (total > 0) {
         double ratio = (double)hits / total * 100.0;
-        std::cout << "Hit ratio: " << ratio << "%\n";
+        out << "Hit ratio: " << ratio << "%\n";
+    }
+}
+
+struct TLBCheckpoint {
+    int capacity;
+    int hits;
+    int misses;
+    size_t time_counter;
+};
+
+void TLB::save(CheckpointWriter& out) const {
+    out.add_value(SectionId::TLB_STATE, TLBCheckpoint {capacity, hits, misses, time_counter});
+
+    out.add(SectionId::TLB_ENTRIES, entries());
+}
+
+static const TLBEntry* read_tlb(const CheckpointReader& in, TLBCheckpoint& state,
+                                size_t& count) {
+    const TLBEntry* saved = in.get<TLBEntry>(SectionId::TLB_ENTRIES, count);
+    if (!in.get_value(SectionId::TLB_STATE, state) || !saved ||
+        state.capacity <= 0 || count > (size_t)state.capacity)
+        return nullptr;
+    return saved;
+}
+
+bool TLB::can_load(const CheckpointReader& in, int num_frames) const {
+    TLBCheckpoint state;
+    size_t count = 0;
+    const TLBEntry* saved = read_tlb(in, state, count);
+    if (!saved)
+        return false;
+    for (size_t i = 0; i < count; i++) {
+        if (saved[i].frame_number < 0 || saved[i].frame_number >= num_frames)
+            return false;
+    }
+    return true;
+}
+
+bool TLB::load(const CheckpointReader& in) {
+    TLBCheckpoint state;
+    size_t count = 0;
+    const TLBEntry* saved = read_tlb(in, state, count);
+    if (!saved)
+        return false;
+
+    capacity = state.capacity;
+    hits = state.hits;
+    misses = state.misses;
+    time_counter = state.time_counter;
+
+    table.clear();
+    lru_list.clear();
+    for (size_t i = 0; i < count; i++) {
+        lru_list.push_back(saved[i].page_number);
+        table[saved[i].page_number] = {saved[i].frame_number, std::prev(lru_list.end())};
+    }
+
+    // The capacity may have changed
+    if (engine) {
+        engine.reset();
+        set_specialized(true);
+    }
+    return true;
+}
+
+// Registry of compiled-in TLB shapes. Only small fully associative TLBs
+// are listed: from about 32 entries a linear scan loses to the hash map.
+namespace {
+
+using TLBFactory = std::unique_ptr<TLBEngine> (*)();
+
+struct TLBShape {
+    size_t entries;
+    size_t ways;
+    TLBFactory make;
+};
+
+template <size_t Entries, size_t Ways>
+TLBShape shape() {
+    return {Entries, Ways, [] { return std::unique_ptr<TLBEngine>(new StaticTLB<Entries, Ways>()); }};
+}
+
+const TLBShape tlb_registry[] = {
+    shape<4, 4>(),
+    shape<8, 8>(),
+    shape<16, 16>()
+};
+
+}
+
+std::unique_ptr<TLBEngine> make_tlb_engine(size_t entries, size_t ways) {
+    for (const TLBShape& s : tlb_registry) {
+        if (s.entries == entries && s.ways == ways)
+            return s.make();
     }
+    return nullptr;
 }
@@ -3,6 +3,10 @@
 
 #include <unordered_map>
 #include <list>
+#include "StaticTLB.h"
+
+class CheckpointWriter;
+class CheckpointReader;
 
 class TLB {
 public:
@@ -10,8 +14,21 @@ public:
 
     bool lookup(int page_number, int &frame_number);
     void insert(int page_number, int frame_number);
+    void invalidate(int page_number);
     void print_stats() const;
 
+    int get_hits() const { return hits; }
+    int get_misses() const { return misses; }
+
+    // As Cache::set_specialized: a fixed-size engine when one matches
+    void set_specialized(bool enabled);
+    bool is_specialized() const { return engine != nullptr; }
+
+    // Entries are saved most recently used first
+    void save(CheckpointWriter& out) const;
+    bool can_load(const CheckpointReader& in, int num_frames) const;
+    bool load(const CheckpointReader& in);
+
 private:
     int capacity;
 
@@ -20,6 +37,12 @@ private:
 
     int hits;
     int misses;
+
+    // Used instead of table and lru_list when set
+    std::unique_ptr<TLBEngine> engine;
+    size_t time_counter;
+
+    std::vector<TLBEntry> entries() const;
 };
 
 #endif
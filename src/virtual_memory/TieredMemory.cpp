@@ -0,0 +1,244 @@
+#include "TieredMemory.h"
+#include <algorithm>
+#include <iostream>
+#include "../io/output.h"
+#include "../checkpoint/checkpoint.h"
+
+TieredMemory::TieredMemory()
+    : is_enabled(false),
+      dram{0, 50, 16},
+      slow{0, 200, 4},
+      migration_interval(64),
+      hot_threshold(4),
+      max_migrations(2),
+      accesses_since_epoch(0),
+      dram_accesses(0),
+      slow_accesses(0),
+      promotions(0),
+      demotions(0),
+      migration_bytes(0),
+      migration_cycles(0) {}
+
+void TieredMemory::configure(const MemoryTier& d, const MemoryTier& s) {
+    is_enabled = true;
+    dram = d;
+    slow = s;
+
+    heat.assign(total_frames(), 0);
+    accesses_since_epoch = 0;
+    dram_accesses = 0;
+    slow_accesses = 0;
+    promotions = 0;
+    demotions = 0;
+    migration_bytes = 0;
+    migration_cycles = 0;
+}
+
+void TieredMemory::set_migration_policy(int interval, int threshold, int max_moves) {
+    migration_interval = std::max(interval, 1);
+    hot_threshold = threshold;
+    max_migrations = max_moves;
+}
+
+TierId TieredMemory::tier_of(int frame) const {
+    return frame < dram.frames ? TierId::DRAM : TierId::SLOW;
+}
+
+int TieredMemory::latency_of(int frame) const {
+    return tier_of(frame) == TierId::DRAM ? dram.latency : slow.latency;
+}
+
+void TieredMemory::record_access(int frame) {
+    heat[frame]++;
+    if (tier_of(frame) == TierId::DRAM)
+        dram_accesses++;
+    else
+        slow_accesses++;
+}
+
+void TieredMemory::reset_frame(int frame) {
+    heat[frame] = 0;
+}
+
+bool TieredMemory::epoch_due() {
+    if (++accesses_since_epoch < migration_interval)
+        return false;
+    accesses_since_epoch = 0;
+    return true;
+}
+
+std::vector<std::pair<int, int>> TieredMemory::plan_migrations(
+    const std::vector<int>& frame_to_page) const {
+
+    std::vector<int> hot;
+    for (int f = dram.frames; f < total_frames(); f++) {
+        if (frame_to_page[f] != -1 && (int)heat[f] >= hot_threshold)
+            hot.push_back(f);
+    }
+    std::sort(hot.begin(), hot.end(),
+        [&](int a, int b) { return heat[a] > heat[b]; });
+
+    // Free DRAM frames first, then the coldest resident DRAM pages
+    std::vector<int> targets;
+    for (int f = 0; f < dram.frames; f++) {
+        if (frame_to_page[f] == -1)
+            targets.push_back(f);
+    }
+    size_t free_targets = targets.size();
+    for (int f = 0; f < dram.frames; f++) {
+        if (frame_to_page[f] != -1)
+            targets.push_back(f);
+    }
+    std::sort(targets.begin() + free_targets, targets.end(),
+        [&](int a, int b) { return heat[a] < heat[b]; });
+
+    std::vector<std::pair<int, int>> plan;
+    for (size_t i = 0; i < hot.size() && i < targets.size(); i++) {
+        if ((int)plan.size() >= max_migrations)
+            break;
+
+        int target = targets[i];
+        if (frame_to_page[target] != -1 && heat[target] >= heat[hot[i]])
+            break;
+
+        plan.push_back({hot[i], target});
+    }
+    return plan;
+}
+
+int TieredMemory::charge_migration(int from_frame, int to_frame, int page_size) {
+    const MemoryTier& src = tier_of(from_frame) == TierId::DRAM ? dram : slow;
+    const MemoryTier& dst = tier_of(to_frame) == TierId::DRAM ? dram : slow;
+
+    int bandwidth = std::max(1, std::min(src.bandwidth, dst.bandwidth));
+    int cycles = src.latency + dst.latency
+               + (page_size + bandwidth - 1) / bandwidth;
+
+    if (tier_of(to_frame) == TierId::DRAM)
+        promotions++;
+    else
+        demotions++;
+
+    migration_bytes += page_size;
+    migration_cycles += cycles;
+    return cycles;
+}
+
+void TieredMemory::swap_heat(int a, int b) {
+    std::swap(heat[a], heat[b]);
+}
+
+void TieredMemory::decay() {
+    for (auto& h : heat)
+        h >>= 1;
+}
+
+void TieredMemory::print_stats(const std::vector<int>& frame_to_page) const {
+    std::ostream& out = Output::stream();
+
+    if (!is_enabled) {
+        out << "Memory tiering disabled\n";
+        return;
+    }
+
+    int dram_resident = 0;
+    int slow_resident = 0;
+    for (int f = 0; f < total_frames(); f++) {
+        if (frame_to_page[f] == -1)
+            continue;
+        if (tier_of(f) == TierId::DRAM)
+            dram_resident++;
+        else
+            slow_resident++;
+    }
+
+    out << "DRAM tier: " << dram.frames << " frames, "
+        << dram.latency << " cycles, "
+        << dram.bandwidth << " B/cycle migration\n";
+    out << "Slow tier: " << slow.frames << " frames, "
+        << slow.latency << " cycles, "
+        << slow.bandwidth << " B/cycle migration\n";
+    out << "Resident pages: DRAM " << dram_resident
+        << ", slow " << slow_resident << "\n";
+
+    size_t total = dram_accesses + slow_accesses;
+    out << "DRAM accesses: " << dram_accesses << "\n";
+    out << "Slow-tier accesses: " << slow_accesses << "\n";
+    if (total > 0) {
+        double dram_rate = (double)dram_accesses / total * 100.0;
+        out << "Served from DRAM: " << dram_rate << "%\n";
+        out << "Served from slow tier: " << 100.0 - dram_rate << "%\n";
+    }
+
+    out << "Promotions: " << promotions << "\n";
+    out << "Demotions: " << demotions << "\n";
+    out << "Migration traffic: " << migration_bytes << " bytes\n";
+    out << "Migration cycles: " << migration_cycles << "\n";
+}
+
+struct TierCheckpoint {
+    bool is_enabled;
+    MemoryTier dram;
+    MemoryTier slow;
+    int migration_interval;
+    int hot_threshold;
+    int max_migrations;
+    int accesses_since_epoch;
+    size_t dram_accesses;
+    size_t slow_accesses;
+    size_t promotions;
+    size_t demotions;
+    size_t migration_bytes;
+    size_t migration_cycles;
+};
+
+void TieredMemory::save(CheckpointWriter& out) const {
+    TierCheckpoint state {is_enabled, dram, slow, migration_interval, hot_threshold,
+                          max_migrations, accesses_since_epoch, dram_accesses,
+                          slow_accesses, promotions, demotions, migration_bytes,
+                          migration_cycles};
+    out.add_value(SectionId::TIER_STATE, state);
+    out.add(SectionId::TIER_HEAT, heat);
+}
+
+// One heat counter per frame of both tiers
+static const unsigned* read_tiers(const CheckpointReader& in, TierCheckpoint& state,
+                                  size_t& count) {
+    const unsigned* saved_heat = in.get<unsigned>(SectionId::TIER_HEAT, count);
+    if (!in.get_value(SectionId::TIER_STATE, state) || !saved_heat ||
+        state.dram.frames < 0 || state.slow.frames < 0 ||
+        count != (size_t)state.dram.frames + state.slow.frames)
+        return nullptr;
+    return saved_heat;
+}
+
+bool TieredMemory::can_load(const CheckpointReader& in, int num_frames) const {
+    TierCheckpoint state;
+    size_t count = 0;
+    return read_tiers(in, state, count) &&
+           (!state.is_enabled || count == (size_t)num_frames);
+}
+
+bool TieredMemory::load(const CheckpointReader& in) {
+    TierCheckpoint state;
+    size_t count = 0;
+    const unsigned* saved_heat = read_tiers(in, state, count);
+    if (!saved_heat)
+        return false;
+
+    is_enabled = state.is_enabled;
+    dram = state.dram;
+    slow = state.slow;
+    migration_interval = state.migration_interval;
+    hot_threshold = state.hot_threshold;
+    max_migrations = state.max_migrations;
+    accesses_since_epoch = state.accesses_since_epoch;
+    dram_accesses = state.dram_accesses;
+    slow_accesses = state.slow_accesses;
+    promotions = state.promotions;
+    demotions = state.demotions;
+    migration_bytes = state.migration_bytes;
+    migration_cycles = state.migration_cycles;
+    heat.assign(saved_heat, saved_heat + count);
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef TIERED_MEMORY_H
+#define TIERED_MEMORY_H
+
+#include <cstddef>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Physical memory split into a fast DRAM tier and a slower (CXL/NVM-like)
+// tier. Frames [0, dram_frames) live in DRAM, the rest in the slow tier.
+struct MemoryTier {
+    int frames;
+    int latency;        // cycles per access
+    int bandwidth;      // bytes per cycle, used to charge page migrations
+};
+
+enum class TierId {
+    DRAM,
+    SLOW
+};
+
+class TieredMemory {
+public:
+    TieredMemory();
+
+    void configure(const MemoryTier& dram, const MemoryTier& slow);
+    void set_migration_policy(int interval, int hot_threshold, int max_migrations);
+
+    bool enabled() const { return is_enabled; }
+    int total_frames() const { return dram.frames + slow.frames; }
+    TierId tier_of(int frame) const;
+    int latency_of(int frame) const;
+
+    // Hotness tracking: a per-frame counter that is halved every epoch
+    void record_access(int frame);
+    void reset_frame(int frame);
+
+    // Returns true when a migration epoch is due after this access
+    bool epoch_due();
+
+    // Picks (slow_frame, dram_frame) pairs to exchange this epoch, hottest
+    // slow pages first. dram_frame may be a free frame.
+    std::vector<std::pair<int, int>> plan_migrations(
+        const std::vector<int>& frame_to_page) const;
+
+    // Charges one page moving between tiers; returns the cycles it cost
+    int charge_migration(int from_frame, int to_frame, int page_size);
+    void swap_heat(int a, int b);
+    void decay();
+
+    void print_stats(const std::vector<int>& frame_to_page) const;
+
+    // can_load() also checks the tiers cover the VM's num_frames
+    void save(CheckpointWriter& out) const;
+    bool can_load(const CheckpointReader& in, int num_frames) const;
+    bool load(const CheckpointReader& in);
+
+private:
+    bool is_enabled;
+    MemoryTier dram;
+    MemoryTier slow;
+
+    int migration_interval;
+    int hot_threshold;
+    int max_migrations;
+    int accesses_since_epoch;
+
+    std::vector<unsigned> heat;
+
+    size_t dram_accesses;
+    size_t slow_accesses;
+    size_t promotions;
+    size_t demotions;
+    size_t migration_bytes;
+    size_t migration_cycles;
+};
+
+#endif
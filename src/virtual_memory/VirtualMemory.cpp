@@ -1,5 +1,9 @@
 #include "VirtualMemory.h"
+#include <algorithm>
 #include <iostream>
+#include "../io/output.h"
+#include "../profile/profiler.h"
+#include "../checkpoint/checkpoint.h"
 
 using namespace std;
 
@@ -7,40 +11,48 @@ VirtualMemory::VirtualMemory(int frames)
     : num_frames(frames),
       page_hits(0),
       page_faults(0),
-      tlb(4) { 
+      tlb(4),
+      stall_cycles(0),
+      clock(0),
+      last_fault_page(-2) { 
 
     frame_to_page.resize(num_frames, -1);
 }
 
-int VirtualMemory::access(int virtual_address) {
+int VirtualMemory::access(size_t virtual_address, bool write) {
     int page_number = virtual_address / PAGE_SIZE;
     int offset = virtual_address % PAGE_SIZE;
+    clock++;
 
-    std::cout << "VM ACCESS: virtual address " << virtual_address << "\n";
-    std::cout << "Page " << page_number << ", Offset " << offset << "\n";
+    MEMSIM_TRACE("VM ACCESS: virtual address " << virtual_address << "\n");
+    MEMSIM_TRACE("Page " << page_number << ", Offset " << offset << "\n");
 
     int frame;
 
     // 1️⃣ TLB lookup
     if (tlb.lookup(page_number, frame)) {
         page_hits++;
-        std::cout << "TLB HIT\n";
-        std::cout << "Page " << page_number << " found in frame " << frame << "\n";
-        std::cout << "Physical address = " 
-                  << frame * PAGE_SIZE + offset << "\n\n";
+        MEMSIM_TRACE("TLB HIT\n");
+        MEMSIM_TRACE("Page " << page_number << " found in frame " << frame << "\n");
+        MEMSIM_TRACE("Physical address = " 
+                     << frame * PAGE_SIZE + offset << "\n\n");
+        settle_page(page_number, write);
+        touch_frame(frame);
         return frame * PAGE_SIZE + offset;
     }
 
-    std::cout << "TLB MISS\n";
+    MEMSIM_TRACE("TLB MISS\n");
 
     // 2️⃣ Page table lookup
     if (page_table.count(page_number) && page_table[page_number].valid) {
-        page_hits++;
+        // A page faulted in ahead by prefault() already counted its fault
+        if (pending_faults.empty() || !pending_faults.erase(page_number))
+            page_hits++;
         frame = page_table[page_number].frame_number;
 
-        std::cout << "PAGE HIT\n";
-        std::cout << "Page " << page_number 
-                  << " mapped to frame " << frame << "\n";
+        MEMSIM_TRACE("PAGE HIT\n");
+        MEMSIM_TRACE("Page " << page_number 
+                     << " mapped to frame " << frame << "\n");
 
         tlb.insert(page_number, frame);
 
@@ -48,52 +60,55 @@ int VirtualMemory::access(int virtual_address) {
         lru_frames.remove(frame);
         lru_frames.push_front(frame);
 
-        std::cout << "Physical address = " 
-                  << frame * PAGE_SIZE + offset << "\n\n";
+        MEMSIM_TRACE("Physical address = " 
+                     << frame * PAGE_SIZE + offset << "\n\n");
 
+        settle_page(page_number, write);
+        touch_frame(frame);
         return frame * PAGE_SIZE + offset;
     }
 
     // 3️⃣ Page fault
-    page_faults++;
-    std::cout << "PAGE FAULT\n";
-
-    handle_page_fault(page_number);
+    MEMSIM_TRACE("PAGE FAULT\n");
+    fault_in(page_number);
 
     frame = page_table[page_number].frame_number;
     tlb.insert(page_number, frame);
 
-    std::cout << "Page " << page_number 
-              << " loaded into frame " << frame << "\n";
-    std::cout << "Physical address = " 
-              << frame * PAGE_SIZE + offset << "\n\n";
+    MEMSIM_TRACE("Physical address = " 
+                 << frame * PAGE_SIZE + offset << "\n\n");
 
+    settle_page(page_number, write);
+    touch_frame(frame);
     return frame * PAGE_SIZE + offset;
 }
 
 void VirtualMemory::dump() const {
-    std::cout << "===== Page Table =====\n";
+    std::ostream& out = Output::stream();
+
+    out << "===== Page Table =====\n";
     for (const auto& [page, entry] : page_table) {
-        std::cout << "Page " << page << ": ";
+        out << "Page " << page << ": ";
         if (entry.valid)
-            std::cout << "VALID  -> Frame " << entry.frame_number;
+            out << "VALID  -> Frame " << entry.frame_number;
         else
-            std::cout << "INVALID";
-        std::cout << "\n";
+            out << "INVALID";
+        out << "\n";
     }
 
-    std::cout << "\n===== Frame Table =====\n";
+    out << "\n===== Frame Table =====\n";
     for (int i = 0; i < num_frames; i++) {
-        std::cout << "Frame " << i << ": ";
+        out << "Frame " << i << ": ";
         if (frame_to_page[i] != -1)
-            std::cout << "Page " << frame_to_page[i];
+            out << "Page " << frame_to_page[i];
         else
-            std::cout << "FREE";
-        std::cout << "\n";
+            out << "FREE";
+        out << "\n";
     }
 }
 
 void VirtualMemory::handle_page_fault(int page_number) {
+    MEMSIM_PROBE(PAGE_FAULT);
     int frame = -1;
 
     // Find free frame
@@ -111,9 +126,19 @@ void VirtualMemory::handle_page_fault(int page_number) {
 
         int victim_page = frame_to_page[victim_frame];
         page_table[victim_page].valid = false;
+        tlb.invalidate(victim_page);
+        if (!pending_faults.empty())
+            pending_faults.erase(victim_page);
+
+        if (swap.enabled()) {
+            if (page_table[victim_page].dirty)
+                swap.write_back(clock);
+            if (page_table[victim_page].prefetched)
+                swap.count_readahead_wasted();
+        }
 
-        std::cout << "Evicting page " << victim_page
-                  << " from frame " << victim_frame << "\n";
+        MEMSIM_TRACE("Evicting page " << victim_page
+                     << " from frame " << victim_frame << "\n");
 
         frame = victim_frame;
     }
@@ -121,23 +146,329 @@ void VirtualMemory::handle_page_fault(int page_number) {
     // Load new page
     page_table[page_number] = PageTableEntry(true, frame);
     frame_to_page[frame] = page_number;
+    if (tiers.enabled())
+        tiers.reset_frame(frame);
 
     // Update LRU
     lru_frames.push_front(frame);
 }
 
+void VirtualMemory::configure_tiers(const MemoryTier& dram, const MemoryTier& slow) {
+    tiers.configure(dram, slow);
+
+    num_frames = tiers.total_frames();
+    frame_to_page.assign(num_frames, -1);
+    page_table.clear();
+    lru_frames.clear();
+    pending_faults.clear();
+    tlb = TLB(4);
+    page_hits = 0;
+    page_faults = 0;
+    stall_cycles = 0;
+}
+
+void VirtualMemory::set_migration_policy(int interval, int hot_threshold, int max_migrations) {
+    tiers.set_migration_policy(interval, hot_threshold, max_migrations);
+}
+
+void VirtualMemory::touch_frame(int frame) {
+    if (!tiers.enabled())
+        return;
+
+    tiers.record_access(frame);
+    if (tiers.epoch_due())
+        run_migration_epoch();
+}
+
+// Promotes hot slow-tier pages into DRAM, demoting the coldest DRAM
+// pages in exchange. Copy cost is charged to the triggering access.
+void VirtualMemory::run_migration_epoch() {
+    for (auto [slow_frame, dram_frame] : tiers.plan_migrations(frame_to_page)) {
+        stall_cycles += tiers.charge_migration(slow_frame, dram_frame, PAGE_SIZE);
+        if (frame_to_page[dram_frame] != -1)
+            stall_cycles += tiers.charge_migration(dram_frame, slow_frame, PAGE_SIZE);
+
+        MEMSIM_TRACE("Migrating page " << frame_to_page[slow_frame]
+                     << " from frame " << slow_frame
+                     << " to frame " << dram_frame << "\n");
+
+        move_page(slow_frame, dram_frame);
+    }
+    tiers.decay();
+}
+
+// Exchanges the pages held by two frames (either may be free)
+void VirtualMemory::move_page(int from_frame, int to_frame) {
+    int from_page = frame_to_page[from_frame];
+    int to_page = frame_to_page[to_frame];
+
+    frame_to_page[from_frame] = to_page;
+    frame_to_page[to_frame] = from_page;
+
+    if (from_page != -1) {
+        page_table[from_page].frame_number = to_frame;
+        tlb.invalidate(from_page);
+    }
+    if (to_page != -1) {
+        page_table[to_page].frame_number = from_frame;
+        tlb.invalidate(to_page);
+    }
+
+    // LRU order follows the pages, not the frames
+    for (auto& f : lru_frames) {
+        if (f == from_frame)
+            f = to_frame;
+        else if (f == to_frame)
+            f = from_frame;
+    }
+
+    tiers.swap_heat(from_frame, to_frame);
+}
+
+void VirtualMemory::configure_swap(const BackingStoreConfig& config) {
+    swap.configure(config);
+    clock = 0;
+    last_fault_page = -2;
+}
+
+// Starts an asynchronous read for a page that already owns a frame
+void VirtualMemory::page_in(int page_number, bool prefetched) {
+    size_t done = swap.read_page(clock);
+    PageTableEntry& entry = page_table[page_number];
+    entry.ready_at = done;
+    entry.prefetched = prefetched;
+
+    if (prefetched)
+        swap.count_readahead();
+    else
+        swap.record_fault(done - clock);
+}
+
+// Waits for an in-flight page-in and records the access on the entry
+void VirtualMemory::settle_page(int page_number, bool write) {
+    PageTableEntry& entry = page_table[page_number];
+    if (write)
+        entry.dirty = true;
+
+    if (entry.ready_at > clock) {
+        size_t wait = entry.ready_at - clock;
+        if (entry.prefetched)
+            swap.count_inflight_wait(wait);
+        stall_cycles += wait;
+        clock = entry.ready_at;
+    }
+
+    // A hit on a readahead page keeps the sequential stream going
+    if (entry.prefetched) {
+        entry.prefetched = false;
+        swap.count_readahead_hit();
+        readahead(page_number);
+    }
+}
+
+void VirtualMemory::readahead(int page_number) {
+    int window = std::min(swap.readahead_window(), num_frames - 1);
+    int current_frame = page_table[page_number].frame_number;
+
+    for (int p = page_number + 1; p <= page_number + window; p++) {
+        auto it = page_table.find(p);
+        if (it != page_table.end() && it->second.valid)
+            continue;
+
+        // Never evict the page that triggered the readahead
+        bool frames_full = (int)lru_frames.size() == num_frames;
+        if (frames_full && lru_frames.back() == current_frame)
+            break;
+
+        handle_page_fault(p);
+        page_in(p, true);
+        MEMSIM_TRACE("Readahead page " << p << " into frame "
+                     << page_table[p].frame_number << "\n");
+    }
+}
+
+// Serves a fault on any path: takes a frame, starts the read from the
+// swap device and follows a sequential fault stream with readahead
+void VirtualMemory::fault_in(int page_number) {
+    page_faults++;
+    handle_page_fault(page_number);
+    MEMSIM_TRACE("Page " << page_number
+                 << " loaded into frame " << page_table[page_number].frame_number << "\n");
+
+    if (swap.enabled()) {
+        page_in(page_number, false);
+        if (page_number == last_fault_page + 1)
+            readahead(page_number);
+        last_fault_page = page_number;
+    }
+}
+
+bool VirtualMemory::prefault(size_t virtual_address) {
+    int page_number = virtual_address / PAGE_SIZE;
+    auto it = page_table.find(page_number);
+    if (!swap.enabled() || (it != page_table.end() && it->second.valid))
+        return false;
+
+    MEMSIM_TRACE("PAGE FAULT (batched)\n");
+    fault_in(page_number);
+    pending_faults.insert(page_number);
+    return true;
+}
+
+void VirtualMemory::print_swap_stats() const {
+    swap.print_stats();
+}
+
+int VirtualMemory::memory_latency(int physical_address) const {
+    if (!tiers.enabled())
+        return RAM_LATENCY;
+    return tiers.latency_of(physical_address / PAGE_SIZE);
+}
+
+int VirtualMemory::take_stall_cycles() {
+    int cycles = stall_cycles;
+    stall_cycles = 0;
+    return cycles;
+}
+
 
 void VirtualMemory::print_stats() const {
-    std::cout << "Page hits: " << page_hits << "\n";
-    std::cout << "Page faults: " << page_faults << "\n";
+    std::ostream& out = Output::stream();
+
+    out << "Page hits: " << page_hits << "\n";
+    out << "Page faults: " << page_faults << "\n";
 
     int total = page_hits + page_faults;
     if (total > 0) {
         double rate = (double)page_faults / total * 100.0;
-        std::cout << "Fault rate: " << rate << "%\n";
+        out << "Fault rate: " << rate << "%\n";
     }
 }
 
+void VirtualMemory::print_tier_stats() const {
+    tiers.print_stats(frame_to_page);
+}
+
 void VirtualMemory::print_tlb_stats() const {
     tlb.print_stats();
 }
+
+struct VMCheckpoint {
+    int num_frames;
+    int page_hits;
+    int page_faults;
+    int stall_cycles;
+    size_t clock;
+    int last_fault_page;
+};
+
+struct PageRecord {
+    int page_number;
+    PageTableEntry entry;
+};
+
+void VirtualMemory::save(CheckpointWriter& out) const {
+    out.add_value(SectionId::VM_STATE, VMCheckpoint {num_frames, page_hits, page_faults,
+                                                     stall_cycles, clock, last_fault_page});
+    out.add(SectionId::VM_FRAMES, frame_to_page);
+
+    vector<PageRecord> pages;
+    pages.reserve(page_table.size());
+    for (const auto& [page, entry] : page_table)
+        pages.push_back({page, entry});
+    out.add(SectionId::VM_PAGES, pages);
+
+    vector<int> fifo;
+    for (queue<int> q = fifo_queue; !q.empty(); q.pop())
+        fifo.push_back(q.front());
+    out.add(SectionId::VM_FIFO, fifo);
+    out.add(SectionId::VM_LRU, vector<int>(lru_frames.begin(), lru_frames.end()));
+
+    tlb.save(out);
+    tiers.save(out);
+    swap.save(out);
+}
+
+// The sections of a VM checkpoint, found but not applied yet
+struct VMSections {
+    VMCheckpoint state;
+    const int* frames = nullptr;
+    const PageRecord* pages = nullptr;
+    const int* fifo = nullptr;
+    const int* lru = nullptr;
+    size_t frame_count = 0, page_count = 0, fifo_count = 0, lru_count = 0;
+
+    bool read(const CheckpointReader& in);
+    bool valid() const;
+};
+
+bool VMSections::read(const CheckpointReader& in) {
+    frames = in.get<int>(SectionId::VM_FRAMES, frame_count);
+    pages = in.get<PageRecord>(SectionId::VM_PAGES, page_count);
+    fifo = in.get<int>(SectionId::VM_FIFO, fifo_count);
+    lru = in.get<int>(SectionId::VM_LRU, lru_count);
+    return in.get_value(SectionId::VM_STATE, state) && frames && pages && fifo && lru
+        && valid();
+}
+
+// Resident pages and their frames must point at each other
+bool VMSections::valid() const {
+    int n = state.num_frames;
+    if (n < 0 || frame_count != (size_t)n || lru_count > frame_count)
+        return false;
+    for (size_t f = 0; f < frame_count; f++) {
+        if (frames[f] < -1)
+            return false;
+    }
+    for (size_t i = 0; i < page_count; i++) {
+        const PageTableEntry& e = pages[i].entry;
+        if (e.valid && (e.frame_number < 0 || e.frame_number >= n ||
+                        frames[e.frame_number] != pages[i].page_number))
+            return false;
+    }
+    for (size_t i = 0; i < fifo_count; i++) {
+        if (fifo[i] < 0 || fifo[i] >= n)
+            return false;
+    }
+    for (size_t i = 0; i < lru_count; i++) {
+        if (lru[i] < 0 || lru[i] >= n)
+            return false;
+    }
+    return true;
+}
+
+bool VirtualMemory::can_load(const CheckpointReader& in) const {
+    VMSections saved;
+    return saved.read(in) && tlb.can_load(in, saved.state.num_frames) &&
+           tiers.can_load(in, saved.state.num_frames) && swap.can_load(in);
+}
+
+bool VirtualMemory::load(const CheckpointReader& in) {
+    if (!can_load(in))
+        return false;
+    VMSections saved;
+    saved.read(in);
+    tlb.load(in);
+    tiers.load(in);
+    swap.load(in);
+
+    const VMCheckpoint& state = saved.state;
+    num_frames = state.num_frames;
+    page_hits = state.page_hits;
+    page_faults = state.page_faults;
+    stall_cycles = state.stall_cycles;
+    clock = state.clock;
+    last_fault_page = state.last_fault_page;
+
+    frame_to_page.assign(saved.frames, saved.frames + saved.frame_count);
+
+    page_table.clear();
+    page_table.reserve(saved.page_count);
+    pending_faults.clear();
+    for (size_t i = saved.page_count; i-- > 0;)
+        page_table[saved.pages[i].page_number] = saved.pages[i].entry;
+
+    fifo_queue = queue<int>(deque<int>(saved.fifo, saved.fifo + saved.fifo_count));
+    lru_frames.assign(saved.lru, saved.lru + saved.lru_count);
+    return true;
+}
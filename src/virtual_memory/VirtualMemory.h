@@ -2,19 +2,26 @@
 #define VIRTUAL_MEMORY_H
 
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <queue>
 #include "TLB.h"
+#include "TieredMemory.h"
+#include "BackingStore.h"
 #include <list>  
 
 struct PageTableEntry {
     bool valid;
     int frame_number;
+    bool dirty;
+    bool prefetched;    // brought in by readahead, not yet touched
+    size_t ready_at;    // time the page-in completes
 
-    PageTableEntry() : valid(false), frame_number(-1) {}
+    PageTableEntry()
+        : valid(false), frame_number(-1), dirty(false), prefetched(false), ready_at(0) {}
 
     PageTableEntry(bool v, int f)
-        : valid(v), frame_number(f) {}
+        : valid(v), frame_number(f), dirty(false), prefetched(false), ready_at(0) {}
 };
 
 class VirtualMemory {
@@ -23,11 +30,44 @@ public:
     VirtualMemory(int frames);
 
     // Takes virtual address, returns physical address
-    int access(int virtual_address);
+    int access(size_t virtual_address, bool write = false);
+    // Issues the page-in of one access in a batch of independent accesses
+    // up front, so the batch's faults overlap on the backing store queue.
+    // The access itself still goes through access(), which waits for the
+    // read and counts the fault, not a hit. Returns true if a page-in was
+    // issued.
+    bool prefault(size_t virtual_address);
+    // Page-ins one batch may issue up front (none without a swap device)
+    int fault_batch_limit() const { return swap.enabled() ? num_frames - 1 : 0; }
     void print_stats() const;
     void print_tlb_stats() const;  
     void dump() const;
 
+    int get_page_hits() const { return page_hits; }
+    int get_page_faults() const { return page_faults; }
+    const TLB& get_tlb() const { return tlb; }
+    void set_specialized_tlb(bool enabled) { tlb.set_specialized(enabled); }
+
+    // Splits physical memory into a DRAM and a slow tier (resets the VM)
+    void configure_tiers(const MemoryTier& dram, const MemoryTier& slow);
+    void set_migration_policy(int interval, int hot_threshold, int max_migrations);
+    void print_tier_stats() const;
+
+    // Puts a swap device behind page faults (disabled = instant page-in)
+    void configure_swap(const BackingStoreConfig& config);
+    void print_swap_stats() const;
+
+    // Latency of a memory access that missed in every cache level
+    int memory_latency(int physical_address) const;
+    // Migration cycles charged since the last call
+    int take_stall_cycles();
+
+    // Page and frame tables, replacement queues, TLB, tiers and swap.
+    // load() changes nothing unless can_load() passes.
+    void save(CheckpointWriter& out) const;
+    bool can_load(const CheckpointReader& in) const;
+    bool load(const CheckpointReader& in);
+
 private:
     static const int PAGE_SIZE = 16; // bytes
 
@@ -48,7 +88,24 @@ private:
     int page_faults;
     TLB tlb;  
 
+    static const int RAM_LATENCY = 50; // cycles, single-tier memory
+    TieredMemory tiers;
+    int stall_cycles;
+
+    BackingStore swap;
+    size_t clock;           // VM-local time in cycles
+    int last_fault_page;
+    // Pages prefault() brought in whose access has not run yet
+    std::unordered_set<int> pending_faults;
+
     void handle_page_fault(int page_number);
+    void fault_in(int page_number);
+    void touch_frame(int frame);
+    void run_migration_epoch();
+    void move_page(int from_frame, int to_frame);
+    void page_in(int page_number, bool prefetched);
+    void settle_page(int page_number, bool write);
+    void readahead(int page_number);
 
 };
 
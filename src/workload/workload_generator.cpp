@@ -0,0 +1,305 @@
+#include "workload_generator.h"
+#include <algorithm>
+#include <cmath>
+#include "../io/tokenizer.h"
+
+WorkloadGenerator::WorkloadGenerator(const WorkloadConfig& config)
+    : config(config),
+      rng(config.seed),
+      cursor_pos(0),
+      cursor_object(0),
+      cursor_offset(0),
+      chase_object(0) {
+    if (this->config.phases.empty())
+        this->config.phases.push_back(WorkloadPhase());
+}
+
+WorkloadStats WorkloadGenerator::run(MemoryManager& heap, WorkloadSink& sink) {
+    WorkloadStats stats;
+
+    for (const WorkloadPhase& phase : config.phases) {
+        for (size_t i = 0; i < phase.ops; i++) {
+            if (live_count() > 0 && uniform() < phase.access_ratio) {
+                touch(phase, heap, sink, stats);
+            } else {
+                // Mostly allocate below the target, mostly free above it
+                bool grow = live_count() < phase.live_target;
+                if (live_count() == 0 || uniform() < (grow ? 0.75 : 0.25))
+                    allocate(phase, sink, stats);
+                else
+                    release(phase, sink, stats);
+            }
+            stats.ops++;
+        }
+    }
+    return stats;
+}
+
+size_t WorkloadGenerator::draw_size(const WorkloadPhase& phase) {
+    switch (phase.sizes) {
+    case SizeDistribution::SIZE_CLASSES:
+        return phase.size_classes[rng() % phase.size_classes.size()];
+
+    case SizeDistribution::POWER_LAW: {
+        // Inverse CDF of a Pareto distribution, clamped to max_size
+        double u = 1.0 - uniform();
+        double size = phase.min_size * std::pow(u, -1.0 / phase.alpha);
+        return (size_t)std::min(size, (double)phase.max_size);
+    }
+
+    case SizeDistribution::BIMODAL:
+        if (uniform() < phase.large_ratio)
+            return phase.max_size / 2 + rng() % (phase.max_size / 2 + 1);
+        return phase.min_size + rng() % (phase.min_size + 1);
+    }
+    return phase.min_size;
+}
+
+void WorkloadGenerator::allocate(const WorkloadPhase& phase, WorkloadSink& sink,
+                                 WorkloadStats& stats) {
+    size_t size = std::max<size_t>(draw_size(phase), 1);
+    int id = sink.alloc(size);
+    if (id == -1) {
+        stats.failed_allocs++;
+        return;
+    }
+
+    uint32_t index = (uint32_t)objects.size();
+    uint32_t next = index;
+    if (live_count() > 0)
+        pick_any(next);
+
+    objects.push_back({id, size, next});
+    alive.push_back(true);
+
+    bool tenure = phase.lifetime == LifetimeModel::GENERATIONAL &&
+                  uniform() < phase.tenured_ratio;
+    LiveSet& set = tenure ? tenured : young;
+    set.order.push_back(index);
+    set.count++;
+
+    stats.allocs++;
+    stats.bytes_allocated += size;
+    stats.peak_live = std::max(stats.peak_live, live_count());
+}
+
+void WorkloadGenerator::release(const WorkloadPhase& phase, WorkloadSink& sink,
+                                WorkloadStats& stats) {
+    uint32_t index;
+    bool found;
+
+    if (phase.lifetime == LifetimeModel::GENERATIONAL) {
+        // Young objects die in allocation order; tenured ones rarely and
+        // in no particular order
+        bool from_tenured = tenured.count > 0 &&
+                            (young.count == 0 || uniform() < phase.tenured_ratio / 4);
+        found = from_tenured ? pick(tenured, LifetimeModel::RANDOM, index)
+                             : pick(young, LifetimeModel::FIFO, index);
+        if (found)
+            remove(from_tenured ? tenured : young, index);
+    } else {
+        found = pick(young, phase.lifetime, index);
+        if (found)
+            remove(young, index);
+    }
+    if (!found)
+        return;
+
+    sink.free(objects[index].block_id);
+    stats.frees++;
+}
+
+void WorkloadGenerator::touch(const WorkloadPhase& phase, MemoryManager& heap,
+                              WorkloadSink& sink, WorkloadStats& stats) {
+    uint32_t index = 0;
+    size_t offset = 0;
+
+    switch (phase.pattern) {
+    case AddressPattern::SEQUENTIAL:
+    case AddressPattern::STRIDED: {
+        size_t step = phase.pattern == AddressPattern::SEQUENTIAL ? 8 : phase.stride;
+        if (cursor_object >= objects.size() || !alive[cursor_object] ||
+            cursor_offset >= objects[cursor_object].size) {
+            // Next live block in allocation order, wrapping around
+            LiveSet& set = young.count > 0 ? young : tenured;
+            size_t pos = cursor_pos + 1;
+            if (pos < set.head || pos >= set.order.size())
+                pos = set.head;
+            while (!alive[set.order[pos]]) {
+                if (++pos >= set.order.size())
+                    pos = set.head;
+            }
+            cursor_pos = pos;
+            cursor_object = set.order[pos];
+            cursor_offset = 0;
+        }
+        index = cursor_object;
+        offset = cursor_offset;
+        cursor_offset += step;
+        break;
+    }
+
+    case AddressPattern::ZIPFIAN: {
+        // Continuous approximation of a Zipf rank over the live blocks,
+        // rank 0 being the oldest
+        LiveSet& set = (tenured.count > 0 && uniform() < 0.5) ? tenured : young;
+        if (set.count == 0) {
+            if (!pick_any(index))
+                return;
+        } else {
+            double n = (double)(set.order.size() - set.head);
+            double u = uniform();
+            double rank = (phase.zipf_s == 1.0)
+                ? std::pow(n, u) - 1.0
+                : std::pow((std::pow(n, 1.0 - phase.zipf_s) - 1.0) * u + 1.0,
+                           1.0 / (1.0 - phase.zipf_s)) - 1.0;
+            size_t pos = set.head + std::min((size_t)rank, set.order.size() - set.head - 1);
+            index = set.order[pos];
+            if (!alive[index] && !pick_any(index))
+                return;
+        }
+        offset = (rng() % objects[index].size) & ~(size_t)7;
+        break;
+    }
+
+    case AddressPattern::POINTER_CHASE:
+        if (chase_object >= objects.size() || !alive[chase_object] ||
+            !alive[objects[chase_object].next] || objects[chase_object].next == chase_object) {
+            if (!pick_any(chase_object))
+                return;
+        } else {
+            chase_object = objects[chase_object].next;
+        }
+        index = chase_object;
+        offset = 0;
+        break;
+    }
+
+    long long start = heap.block_start(objects[index].block_id);
+    if (start < 0)
+        return;
+
+    sink.access((size_t)start + offset, uniform() < phase.write_ratio);
+    stats.accesses++;
+}
+
+// Uniform pick over all live objects
+bool WorkloadGenerator::pick_any(uint32_t& index) {
+    LiveSet& set = (tenured.count > 0 && rng() % live_count() < tenured.count)
+                   ? tenured : young;
+    return pick(set, LifetimeModel::RANDOM, index);
+}
+
+bool WorkloadGenerator::pick(LiveSet& set, LifetimeModel model, uint32_t& index) {
+    if (set.count == 0)
+        return false;
+
+    switch (model) {
+    case LifetimeModel::LIFO:
+        while (!alive[set.order.back()])
+            set.order.pop_back();
+        index = set.order.back();
+        return true;
+
+    case LifetimeModel::FIFO:
+    case LifetimeModel::GENERATIONAL:
+        while (!alive[set.order[set.head]])
+            set.head++;
+        index = set.order[set.head];
+        return true;
+
+    case LifetimeModel::RANDOM:
+        // tidy() keeps at least half the window alive
+        do {
+            index = set.order[set.head + rng() % (set.order.size() - set.head)];
+        } while (!alive[index]);
+        return true;
+    }
+    return false;
+}
+
+void WorkloadGenerator::remove(LiveSet& set, uint32_t index) {
+    alive[index] = false;
+    set.count--;
+    tidy(set);
+}
+
+void WorkloadGenerator::tidy(LiveSet& set) {
+    while (set.head < set.order.size() && !alive[set.order[set.head]])
+        set.head++;
+    while (!set.order.empty() && !alive[set.order.back()])
+        set.order.pop_back();
+
+    if (set.order.size() - set.head > 2 * set.count + 16) {
+        std::vector<uint32_t> kept;
+        kept.reserve(set.count);
+        for (size_t i = set.head; i < set.order.size(); i++) {
+            if (alive[set.order[i]])
+                kept.push_back(set.order[i]);
+        }
+        set.order.swap(kept);
+        set.head = 0;
+    }
+}
+
+bool WorkloadGenerator::parse_setting(std::string_view setting, WorkloadPhase& phase) {
+    size_t eq = setting.find('=');
+    if (eq == std::string_view::npos)
+        return false;
+    std::string_view key = setting.substr(0, eq);
+    std::string_view value = setting.substr(eq + 1);
+
+    if (key == "ops")           return Tokenizer::parse_number(value, phase.ops);
+    if (key == "access")        return Tokenizer::parse_number(value, phase.access_ratio);
+    if (key == "write")         return Tokenizer::parse_number(value, phase.write_ratio);
+    if (key == "min")           return Tokenizer::parse_number(value, phase.min_size);
+    if (key == "max")           return Tokenizer::parse_number(value, phase.max_size);
+    if (key == "alpha")         return Tokenizer::parse_number(value, phase.alpha);
+    if (key == "large")         return Tokenizer::parse_number(value, phase.large_ratio);
+    if (key == "live")          return Tokenizer::parse_number(value, phase.live_target);
+    if (key == "tenured")       return Tokenizer::parse_number(value, phase.tenured_ratio);
+    if (key == "stride")        return Tokenizer::parse_number(value, phase.stride);
+    if (key == "zipf")          return Tokenizer::parse_number(value, phase.zipf_s);
+
+    if (key == "classes") {
+        // classes=16,48,256
+        std::vector<size_t> classes;
+        while (!value.empty()) {
+            size_t comma = value.find(',');
+            size_t size;
+            if (!Tokenizer::parse_number(value.substr(0, comma), size) || size == 0)
+                return false;
+            classes.push_back(size);
+            value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+        }
+        if (classes.empty())
+            return false;
+        phase.size_classes = classes;
+        phase.sizes = SizeDistribution::SIZE_CLASSES;
+        return true;
+    }
+    if (key == "sizes") {
+        if (value == "classes")         phase.sizes = SizeDistribution::SIZE_CLASSES;
+        else if (value == "power_law")  phase.sizes = SizeDistribution::POWER_LAW;
+        else if (value == "bimodal")    phase.sizes = SizeDistribution::BIMODAL;
+        else return false;
+        return true;
+    }
+    if (key == "lifetime") {
+        if (value == "lifo")                phase.lifetime = LifetimeModel::LIFO;
+        else if (value == "fifo")           phase.lifetime = LifetimeModel::FIFO;
+        else if (value == "random")         phase.lifetime = LifetimeModel::RANDOM;
+        else if (value == "generational")   phase.lifetime = LifetimeModel::GENERATIONAL;
+        else return false;
+        return true;
+    }
+    if (key == "pattern") {
+        if (value == "sequential")      phase.pattern = AddressPattern::SEQUENTIAL;
+        else if (value == "strided")    phase.pattern = AddressPattern::STRIDED;
+        else if (value == "zipf")       phase.pattern = AddressPattern::ZIPFIAN;
+        else if (value == "chase")      phase.pattern = AddressPattern::POINTER_CHASE;
+        else return false;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../allocator/memory_manager.h"
+
+enum class SizeDistribution {
+    SIZE_CLASSES,   // uniform over a fixed set of sizes
+    POWER_LAW,      // Pareto: many small, a long tail of large
+    BIMODAL         // small objects plus a fraction of large buffers
+};
+
+enum class LifetimeModel {
+    LIFO,
+    FIFO,
+    RANDOM,
+    GENERATIONAL    // most objects die young, a few are tenured
+};
+
+enum class AddressPattern {
+    SEQUENTIAL,     // word by word through live blocks in allocation order
+    STRIDED,
+    ZIPFIAN,        // skewed towards the oldest live blocks
+    POINTER_CHASE   // each block points at a random older block
+};
+
+// One stretch of the workload; a run goes through its phases in order
+struct WorkloadPhase {
+    size_t ops = 100000;
+    double access_ratio = 0.8;      // share of ops that are accesses
+    double write_ratio = 0.3;       // share of accesses that are writes
+
+    SizeDistribution sizes = SizeDistribution::SIZE_CLASSES;
+    std::vector<size_t> size_classes = {16, 32, 64, 128, 256};
+    size_t min_size = 16;
+    size_t max_size = 4096;
+    double alpha = 1.2;             // power-law tail exponent
+    double large_ratio = 0.1;       // bimodal share of large objects
+
+    LifetimeModel lifetime = LifetimeModel::RANDOM;
+    size_t live_target = 1000;      // allocs and frees hover around this
+    double tenured_ratio = 0.1;     // generational share of long-lived objects
+
+    AddressPattern pattern = AddressPattern::ZIPFIAN;
+    size_t stride = 64;
+    double zipf_s = 1.0;
+};
+
+struct WorkloadConfig {
+    uint64_t seed = 1;
+    std::vector<WorkloadPhase> phases;
+};
+
+// Where generated operations go: straight into a simulator, or into a
+// trace file
+class WorkloadSink {
+public:
+    virtual ~WorkloadSink() = default;
+    virtual int alloc(size_t size) = 0;     // block id or -1
+    virtual void free(int block_id) = 0;
+    virtual void access(size_t address, bool write) = 0;
+};
+
+struct WorkloadStats {
+    size_t ops = 0;
+    size_t allocs = 0;
+    size_t failed_allocs = 0;
+    size_t frees = 0;
+    size_t accesses = 0;
+    size_t bytes_allocated = 0;
+    size_t peak_live = 0;
+};
+
+// Drives a seeded mix of allocations, frees and accesses. Access addresses
+// are payload addresses of live blocks in heap, looked up at access time,
+// so they follow compaction.
+class WorkloadGenerator {
+public:
+    explicit WorkloadGenerator(const WorkloadConfig& config);
+
+    WorkloadStats run(MemoryManager& heap, WorkloadSink& sink);
+
+    // Applies one "key=value" setting to a phase; false if not understood
+    static bool parse_setting(std::string_view setting, WorkloadPhase& phase);
+
+private:
+    struct LiveObject {
+        int block_id;
+        size_t size;
+        uint32_t next;      // pointer-chase successor (allocation index)
+    };
+
+    // Live objects in allocation order. Frees mark entries dead; the
+    // vector is compacted once most of it is dead.
+    struct LiveSet {
+        std::vector<uint32_t> order;    // allocation indices
+        size_t head = 0;                // first entry that may be alive
+        size_t count = 0;
+    };
+
+    WorkloadConfig config;
+    std::mt19937_64 rng;
+
+    std::vector<LiveObject> objects;    // by allocation index
+    std::vector<bool> alive;
+    LiveSet young;
+    LiveSet tenured;                    // only used by GENERATIONAL
+
+    // Address stream state
+    size_t cursor_pos;                  // sequential walk position in its LiveSet
+    uint32_t cursor_object;
+    size_t cursor_offset;
+    uint32_t chase_object;
+
+    double uniform() { return std::uniform_real_distribution<double>(0.0, 1.0)(rng); }
+    size_t draw_size(const WorkloadPhase& phase);
+    size_t live_count() const { return young.count + tenured.count; }
+
+    void allocate(const WorkloadPhase& phase, WorkloadSink& sink, WorkloadStats& stats);
+    void release(const WorkloadPhase& phase, WorkloadSink& sink, WorkloadStats& stats);
+    void touch(const WorkloadPhase& phase, MemoryManager& heap,
+               WorkloadSink& sink, WorkloadStats& stats);
+
+    bool pick_any(uint32_t& index);
+    bool pick(LiveSet& set, LifetimeModel model, uint32_t& index);
+    void remove(LiveSet& set, uint32_t index);
+    void tidy(LiveSet& set);
+};